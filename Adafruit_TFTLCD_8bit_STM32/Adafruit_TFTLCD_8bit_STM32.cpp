@@ -5,6 +5,7 @@
 #include "Adafruit_TFTLCD_8bit_STM32_priv.h"
 #include "MapleFreeRTOS1000_pp.h"
 #include "fancyLock.h"
+#include <new>
  FancyLock PortAMutex;  ;
 
 uint32_t intReg;
@@ -173,6 +174,40 @@ uint16_t readReg(uint8_t r)
   return id;
 }
 
+/*****************************************************************************/
+// Frame memory read cycle is ~450 ns, much shorter than the register one
+// so read8_ with its 30 us is way too slow for a whole screen
+// RD must stay low >= 355 ns and high >= 90 ns (ILI9341), hence a delay on both sides
+#define readPixel8(x) { RD_ACTIVE; delayMicroseconds(1); x = ( (dataRegs->IDR>>TFT_DATA_SHIFT) & 0x00FF); RD_IDLE; delayMicroseconds(1); }
+/**
+ * \brief Read back w pixels of line y starting at x, as RGB332 (RRRGGGBB)
+ * The controller sends a dummy byte then 3 bytes per pixel, 6 significant bits each.
+ * The first byte holds the high field of the 565 word, i.e. blue on ILI9341 (see MK_COLOR)
+ * Keep w small, the port is held (and the buttons masked) during the read
+ */
+void Adafruit_TFTLCD_8bit_STM32::readPixels332(int x, int y, int w, uint8_t *out)
+{
+  uint8_t hi,mid,lo;
+  setAddrWindow(x,y,x+w-1,y);
+  writeCommand(0x2E); // RAMRD
+  setReadDir();
+  CD_DATA;
+  readPixel8(hi); // dummy
+  for(int i=0;i<w;i++)
+  {
+    readPixel8(hi);
+    readPixel8(mid);
+    readPixel8(lo);
+    if(displayIdentifier!=0x7789)
+    {
+        uint8_t t=hi;hi=lo;lo=t;
+    }
+    out[i]=(hi&0xE0)|((mid>>3)&0x1C)|(lo>>6);
+  }
+  CS_IDLE;
+  setWriteDir();
+}
+
 /*****************************************************************************/
 void writeRegister8(uint16_t a, uint8_t d)
 {
@@ -480,12 +515,20 @@ void Adafruit_TFTLCD_8bit_STM32::pushColors(uint16_t *data, int len, boolean fir
 #include "ili9341.h"
 #include "st7789.h"
 
+/**
+ * \brief Only one display lives, until power off, so it goes in a static buffer
+ * large enough for any of the controllers instead of the heap
+ */
+#define TFT_STORAGE_SIZE (sizeof(Adafruit_TFTLCD_8bit_STM32_ST7789)>sizeof(Adafruit_TFTLCD_8bit_STM32_ILI9341) ? \
+                            sizeof(Adafruit_TFTLCD_8bit_STM32_ST7789) : sizeof(Adafruit_TFTLCD_8bit_STM32_ILI9341))
+static uint8_t tftStorage[TFT_STORAGE_SIZE] __attribute__((aligned(8)));
+
 Adafruit_TFTLCD_8bit_STM32 *Adafruit_TFTLCD_8bit_STM32::spawn(int id)
 {
     switch(id)
     {
-        case 0x7789: return  new Adafruit_TFTLCD_8bit_STM32_ST7789;break;
-        case 0x9341: return  new Adafruit_TFTLCD_8bit_STM32_ILI9341;break;
+        case 0x7789: return  new(tftStorage) Adafruit_TFTLCD_8bit_STM32_ST7789;break;
+        case 0x9341: return  new(tftStorage) Adafruit_TFTLCD_8bit_STM32_ILI9341;break;
         default : return NULL;
     }
     return NULL;    
@@ -104,6 +104,7 @@ class Adafruit_TFTLCD_8bit_STM32 : public Adafruit_GFX
 
   void     drawBitmap(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t * bitmap);
   static uint16_t readID(void);
+  void     readPixels332(int x, int y, int w, uint8_t *out);
 /*****************************************************************************/
 // Pass 8-bit (each) R,G,B, get back 16-bit packed color
 // color coding on bits:
@@ -129,6 +130,7 @@ public:
     void  setFontFamily(const GFXfont *small, const GFXfont *medium, const GFXfont *big);
     void  myDrawString(const char *st, int padd_up_to_n_pixels=0);
     void  myDrawStringN(const char *st,int length,int padd_up_to_n_pixels=0);
+    int   myStringWidth(const char *st,int length);
     void  setFontSize(FontSize size);
     //
     void drawBitmap(int width, int height, int wx, int wy, int fgcolor, int bgcolor, const uint8_t *data);
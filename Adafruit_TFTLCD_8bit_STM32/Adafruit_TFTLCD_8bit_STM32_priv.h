@@ -43,6 +43,10 @@ extern FancyLock PortAMutex;  ;
 #define RST_LOW      { GPIOB->regs->BRR  = TFT_RST_MASK; }
 #define CS_IDLE	 { GPIOC->regs->BSRR = TFT_CS_MASK; }
 
+// The buttons (PB3..PB7) share the data bus, the edges they see during a transfer
+// are just data : they are masked while CS is active and forgotten afterward
+#define TFT_BUTTON_EXTI_LINES 0xF8
+
 #ifndef USE_RXTX_PIN_FOR_ROTARY
 
 #define CS_ACTIVE  { \
@@ -56,22 +60,27 @@ extern FancyLock PortAMutex;  ;
 #define CS_IDLE    { GPIOB->regs->ODR = opReg;\
                     GPIOB->regs->CRL = 0x88888888; \
                     GPIOC->regs->BSRR = TFT_CS_MASK ; \
+                    EXTI_BASE->PR = TFT_BUTTON_EXTI_LINES; \
                     EXTI_BASE->IMR = intReg;  \
                     PortAMutex.unlock(); \
                     }
 
 
-#else // when RX/TX pins are used for rotary encoder, no need to mask interrupts
-#define CS_ACTIVE  {  \        
+#else // when RX/TX pins are used for rotary encoder, only the buttons need to be masked
+#define CS_ACTIVE  {  \
                     PortAMutex.lock(); \
-                    opReg = GPIOB->regs->ODR;\                    
+                    intReg = EXTI_BASE->IMR;\
+                    opReg = GPIOB->regs->ODR;\
+                    EXTI_BASE->IMR = intReg & ~TFT_BUTTON_EXTI_LINES ; \
                     GPIOB->regs->CRL = 0x33333333 ;\
                     GPIOC->regs->BRR  = TFT_CS_MASK; }
 
-#define CS_IDLE    { \                    
+#define CS_IDLE    { \
                     GPIOB->regs->ODR = opReg;\
                     GPIOB->regs->CRL = 0x88888888; \
                     GPIOC->regs->BSRR = TFT_CS_MASK ; \
+                    EXTI_BASE->PR = TFT_BUTTON_EXTI_LINES; \
+                    EXTI_BASE->IMR = intReg;  \
                     PortAMutex.unlock(); \
                     }
 
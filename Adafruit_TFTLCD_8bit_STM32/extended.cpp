@@ -60,6 +60,28 @@ void  Adafruit_TFTLCD_8bit_STM32::myDrawStringN(const char *st,int length,int pa
      myDrawStringN(st,l,padd_up_to_n_pixels);
  }
 
+/**
+ * \fn myStringWidth
+ * \brief width in pixels of the first length chars of st with the current font
+ * @param st
+ * @param length
+ * @return 
+ */
+int  Adafruit_TFTLCD_8bit_STM32::myStringWidth(const char *st,int length)
+{
+    if(!currentFont)
+        return 0;
+    const GFXfont *font=currentFont->font;
+    int w=0;
+    for(int i=0;i<length;i++)
+    {
+        unsigned char c=st[i];
+        if(c<font->first || c>font->last) continue;
+        w+=font->glyph[c-font->first].xAdvance;
+    }
+    return w;
+}
+
 /**
  * 
  * @param size
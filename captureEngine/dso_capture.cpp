@@ -7,10 +7,12 @@
 #include "dso_adc.h"
 #include "dso_capture.h"
 #include "dso_capture_priv.h"
-
+#include "dso_adc_gain.h"
 #include "DSO_config.h"
+#include "dso_perf.h"
 #include "stopWatch.h"
 #include "qfp.h"
+#include "dso_static.h"
 
  
 
@@ -23,18 +25,21 @@ float    DSOCapturePriv::triggerValueFloat=0;
 float     DSOCapturePriv::voltageOffset=0;
 DSOCapturePriv::TaskletMode DSOCapturePriv::taskletMode;
 FancySemaphore *captureSemaphore=NULL;
+static DSOStatic<FancySemaphore> captureSemaphoreStorage;
 static TaskHandle_t captureTaskHandle;
+DSO_STATIC_TASK(capture,DSO_CAPTURE_TASK_STACK)
 
 extern StopWatch watch;
 CapturedSet DSOCapturePriv::captureSet[2];
+static uint32_t captureSequence=0;
 
 /**
  * 
  */
 void DSOCapture::initialize()
 {
-    captureSemaphore=new FancySemaphore;
-    xTaskCreate( (TaskFunction_t)DSOCapturePriv::task, "Capture", 200, NULL, DSO_CAPTURE_TASK_PRIORITY, &captureTaskHandle );    
+    captureSemaphore=captureSemaphoreStorage.create();
+    captureTaskHandle=xTaskCreateStatic( (TaskFunction_t)DSOCapturePriv::task, "Capture", DSO_CAPTURE_TASK_STACK, NULL, DSO_CAPTURE_TASK_PRIORITY, captureStack, &captureTcb );
 }
 /**
  * 
@@ -159,6 +164,32 @@ int DSOCapturePriv::voltToADCValue(float v)
     return (int)out;    
 }
 
+/**
+ * \fn recordConversion
+ * \brief Called by the tasklets when the samples are converted, so that the consumer
+ * gets the settings that were actually used, even if they changed since
+ * Same as the transform : when the linearity correction is on, the codes are in 1/16 LSB
+ */
+void DSOCapturePriv::recordConversion(CaptureStats &stats, int dc0_ac1, bool triggered)
+{
+    float offset=DSOInputGain::getOffset(dc0_ac1);
+    float multiplier=DSOInputGain::getMultiplier();
+    stats.codeBits=12;
+    if(DSOInputGain::getLinearity())
+    {
+        offset*=16.;
+        multiplier/=16.;
+        stats.codeBits=16;
+    }
+    stats.codeScale=multiplier;
+    stats.codeOffset=offset;
+    stats.coupling=dc0_ac1;
+    stats.triggered=triggered;
+    stats.timeBase=DSOCapture::getTimeBase(); // global index, currentTimeBase is within the current table
+    stats.voltageRange=currentVoltageRange;
+    stats.sampleInterval=getSampleInterval();
+}
+
 void DSOCapturePriv::InternalStopCapture()
 {
     stopCapture();
@@ -242,6 +273,7 @@ int DSOCapturePriv::triggeredCapture(int count,float *volt,CaptureStats &stats)
 
      memcpy(volt,set->data,toCopy*sizeof(float));
      stats=set->stats;
+     stats.sequence=++captureSequence;
      //xDelay(10);
      
      return toCopy;
@@ -272,18 +304,10 @@ bool DSOCapture::captureToDisplay(int count,float *samples,uint8_t *waveForm)
         // 590 with qfp
         // 260 with qfp and cast to int
 
-#if 1
-    #define DBG(x) x
-#else
-    #define DBG(...) 
-#endif
-DBG(uint32_t capcapcap[16];)
-DBG(uint32_t capIndex;)
-  
-        
+
 bool DSOCapture::captureToDisplay(int count,float *samples,uint8_t *waveForm)
 {    
-    DBG(uint32_t before=micros());
+    uint32_t before=micros();
     float gain=vSettings[DSOCapturePriv::currentVoltageRange].displayGain;
     //uint32_t before=micros();
     float offset=(float)(DSO_WAVEFORM_HEIGHT/2)-((float)DSOCapturePriv::voltageOffset*gain*8.)/10.;
@@ -298,9 +322,7 @@ bool DSOCapture::captureToDisplay(int count,float *samples,uint8_t *waveForm)
             if(vint<0) vint=0;           
             waveForm[j]=(uint8_t)vint;
         }
-    DBG(uint32_t duration=micros()-before);
-    DBG(capcapcap[capIndex]=duration);
-    DBG(capIndex=(capIndex+1)&0xf);
+    DSOPerf::add(DSOPerf::PERF_TRANSFORM,micros()-before);
     return true;
 }
 #endif
@@ -466,10 +488,17 @@ int DSOCapture::voltToADCValue(float v)
  * @return 
  */
 float        DSOCapture::getMaxVoltageValue()
+{
+    return getMaxVoltageValue((DSO_VOLTAGE_RANGE)DSOCapturePriv::currentVoltageRange);
+}
+/**
+ * \brief Same for a given range, without switching to it
+ */
+float        DSOCapture::getMaxVoltageValue(DSO_VOLTAGE_RANGE range)
 {
      // we want to have less than 80% pixels= 100 (i.e. half screen), else it means saturation
    
-    float gain=vSettings[DSOCapturePriv::currentVoltageRange].displayGain;
+    float gain=vSettings[range].displayGain;
     float v=116./gain;
     return v;
 }
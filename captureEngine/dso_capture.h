@@ -14,6 +14,17 @@ typedef struct
   int   trigger;   // -1 = no trigger; else offset
   int   frequency; //  0 or -1= unknown
   bool  saturation;
+  uint32_t sequence;      // capture number since boot
+  uint32_t timestamp;     // ms since boot, when the samples were processed
+  float    sampleInterval;// s between two samples
+  // How the samples were converted, recorded by the capture tasklet : volt=(code-codeOffset)*codeScale
+  float    codeScale;     // volt per code
+  float    codeOffset;    // code for 0 volt
+  uint8_t  codeBits;      // 12 : ADC codes, 16 : 1/16 LSB (linearity correction active)
+  uint8_t  coupling;      // 0 DC, 1 AC
+  uint8_t  timeBase;      // DSO_TIME_BASE
+  uint8_t  voltageRange;  // DSO_VOLTAGE_RANGE
+  bool     triggered;     // false in Run mode, trigger is then only where the trace is centered
 }CaptureStats;
 
 /**
@@ -93,6 +104,7 @@ public:
     static DSO_TIME_BASE getTimeBase();
     static const char *getTimeBaseAsText();
     static int         timeBaseToFrequency(DSO_TIME_BASE timeBase);
+    static float       getSampleInterval();
     // Trigger
     static void        updateTriggersValue();
     static void        setTriggerValue(float volt);
@@ -116,6 +128,7 @@ public:
     
     // needed by autoSetup
     static float        getMaxVoltageValue();
+    static float        getMaxVoltageValue(DSO_VOLTAGE_RANGE range);
     static float        getMinVoltageValue();
 
 };
@@ -8,6 +8,7 @@
 #include "dso_capture.h"
 #include "dso_capture_priv.h"
 #include "DSO_config.h"
+#include "dso_perf.h"
 #include "dso_adc_gain.h"
 #include  "qfp.h"
 
@@ -71,29 +72,15 @@ static void swapADCs_asm(int nb, uint16_t *data)
             : : : "memory");
 }
 
-bool adc2InUse=false;
-// we filter out multiple call to stop()
+volatile bool adc2InUse=false;
+/**
+ * \brief Flag ADC2 as used by the DMA capture, the control task only samples the coupling pin when it is free
+ * Not a lock : start/stop are not paired (nextCapture re-arms from the tasklet) and they
+ * don't run in the same task
+ */
 void captureAdc2(bool use)
 {
-    return;
-    if(use)
-    {
-        if(!adc2InUse) //xAssert(!adc2InUse);
-        {
-            adc2InUse=true;
-            useAdc2(true);
-        }else xAssert(0);
-    }else
-    {
-        if(adc2InUse)
-        {
-             useAdc2(false);
-             adc2InUse=false;
-        }
-        //else xAssert(0);
-    }
-    
-    
+    adc2InUse=use;
 }
 static void swapADCs(int nb, uint16_t *data)
 {    
@@ -212,13 +199,27 @@ void checkAvgMinMax(int count, int16_t *in,CaptureStats &stats,int swing,float o
        if(v<swing)        stats.saturation=true;
        if(v>(4096-swing)) stats.saturation=true;
    }
-   // compute avg
-   f=(float)sum;
-   f/=count;
-   f-=offset;
-   f*=multiplier;     
-   stats.avg=f;
-   
+   const int16_t *lin=DSOInputGain::getLinearity();
+   if(lin) // the correction is monotonic, we can apply it to the extremes
+   {
+       int avg=(sum+count/2)/count;
+       f=(float)DSOInputGain::linearize16(lin,avg)/16.;
+       f-=offset;
+       f*=multiplier;     
+       stats.avg=f;
+       xmax=DSOInputGain::linearize16(lin,xmax);
+       xmin=DSOInputGain::linearize16(lin,xmin);
+       offset*=16.;
+       multiplier/=16.;
+   }else
+   {
+        // compute avg
+        f=(float)sum;
+        f/=count;
+        f-=offset;
+        f*=multiplier;     
+        stats.avg=f;
+   }
    // Compute min max
    f=(float)xmax;
    f=QSUB(f,offset);
@@ -247,7 +248,19 @@ int transformDmaExact(int dc0_ac1,int16_t *in, float *out,int count, CaptureStat
    multiplier=DSOInputGain::getMultiplier();
    
    checkAvgMinMax(count,in,stats,swing,offset,multiplier);
-  
+   const int16_t *lin=DSOInputGain::getLinearity();
+   if(lin) // corrected, work in 1/16 LSB
+   {
+    offset*=16.;
+    multiplier/=16.;
+    for(int i=0;i<count;i++)
+    {
+        f=DSOInputGain::linearize16(lin,*(in+i));
+        f=QSUB(f,offset);
+        f=QMUL(f,multiplier);
+        out[i]=f; // Unit is now in volt        
+    }   
+   }else
    // med
    {   
     for(int i=0;i<count;i++)
@@ -302,7 +315,21 @@ static int transformDma(int dc0_ac1,int16_t *in, float *out,int count, int expan
    
    // search min/max, take all the samples
    checkAvgMinMax(count,in,stats,swing,offset,multiplier);
- 
+   const int16_t *lin=DSOInputGain::getLinearity();
+   if(lin) // corrected, work in 1/16 LSB
+   {
+    offset*=16.;
+    multiplier/=16.;
+    float f;
+    for(int i=0;i<ocount;i++)
+    {
+        f=DSOInputGain::linearize16(lin,*(in+(dex/4096)));
+        f=QSUB(f,offset);
+        f=QMUL(f,multiplier);
+        out[i]=f; // Unit is now in volt
+        dex+=expand;
+    }   
+   }else
    {   
     float f;
     for(int i=0;i<ocount;i++)
@@ -416,6 +443,7 @@ void DSOCapturePriv::stopCaptureDma()
 {
     VERBOSE("Dma stop\n");
     adc->stopDmaCapture();    
+    captureAdc2(false);
     
 }
 /**
@@ -488,11 +516,13 @@ bool DSOCapturePriv::taskletDmaCommon(const bool trigger)
         nextCapture();
         return false;
     }
+    uint32_t startUs=micros();
     captureAdc2(false); // ok we can unlock the adc2
     CapturedSet *set=captureSet;
     
     set->stats.trigger=-1;     
     set->stats.frequency=-1;
+    set->stats.timestamp=millis();
     
     // We have XX*expand/4096 sample in and XX samples out
     
@@ -522,7 +552,9 @@ bool DSOCapturePriv::taskletDmaCommon(const bool trigger)
         set->stats.trigger=120; // right in the middle        
     }
     p=((int16_t *)fset.set1.data);
-    set->samples=transformDma(      INDEX_AC1_DC0(),
+    int dc0_ac1=INDEX_AC1_DC0();
+    recordConversion(set->stats,dc0_ac1,trigger);
+    set->samples=transformDma(      dc0_ac1,
                                     p,
                                     data,
                                     fset.set1.samples,
@@ -541,6 +573,7 @@ bool DSOCapturePriv::taskletDmaCommon(const bool trigger)
             set->stats.frequency=f;
     }else
          set->stats.frequency=0;
+    DSOPerf::add(DSOPerf::PERF_CAPTURE,micros()-startUs);
     // Data ready!
     captureSemaphore->give();
     return true;
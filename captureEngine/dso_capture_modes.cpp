@@ -126,6 +126,19 @@ const char *DSOCapture::getTimeBaseAsText()
 {
    return currentTable->getTimeBaseAsText();        
 }
+/**
+ * \brief Time between two samples as returned by capture(), in seconds
+ * The fast modes resample the ADC output, expand4096/4096 input samples per output sample
+ */
+float DSOCapture::getSampleInterval()
+{
+    if(getTimeBase()<=DSO_TIME_BASE::SLOWER_FAST_MODE)
+    {
+        const TimeSettings &t=tSettings[DSOCapturePriv::currentTimeBase];
+        return ((float)t.expand4096)/(4096.*(float)t.fqInHz);
+    }
+    return 1./(float)timerBases[DSOCapturePriv::currentTimeBase].fq;
+}
 /**
  * 
  * @param count
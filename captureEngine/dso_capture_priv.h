@@ -73,6 +73,7 @@ public:
     static bool        prepareSamplingDma ();
     static bool        prepareSamplingTimer ();
     static int         voltToADCValue(float v);
+    static void        recordConversion(CaptureStats &stats, int dc0_ac1, bool triggered);
     static int         computeFrequency(int samples,uint16_t *data);
     static void        stopCaptureDma();
     static void        stopCaptureTimer();
@@ -9,6 +9,7 @@
 #include "dso_capture_priv.h"
 #include "dso_adc_gain.h"
 #include "DSO_config.h"
+#include "dso_perf.h"
 
 extern int transformDmaExact(int dc0_ac1,int16_t *in, float *out,int count, CaptureStats &stats, float triggerValue, DSOADC::TriggerMode mode,int swing);
 
@@ -93,11 +94,13 @@ bool DSOCapturePriv::taskletTimerCommon(bool trigger)
         nextCapture();
         return false;
     }
+    uint32_t startUs=micros();
 
     CapturedSet *set=captureSet;
     
     set->stats.trigger=-1;     
     set->stats.frequency=-1;
+    set->stats.timestamp=millis();
     float *data=set->data;    
     p=((int16_t *)fset.set1.data);
 
@@ -117,7 +120,9 @@ bool DSOCapturePriv::taskletTimerCommon(bool trigger)
         set->stats.trigger=120; // right in the middle
     }
     p=((int16_t *)fset.set1.data);
-    set->samples=transformDmaExact(      INDEX_AC1_DC0(),
+    int dc0_ac1=INDEX_AC1_DC0();
+    recordConversion(set->stats,dc0_ac1,trigger);
+    set->samples=transformDmaExact(      dc0_ac1,
                                     p,
                                     data,
                                     fset.set1.samples,
@@ -138,6 +143,7 @@ bool DSOCapturePriv::taskletTimerCommon(bool trigger)
     {
          set->stats.frequency=0;
     }
+    DSOPerf::add(DSOPerf::PERF_CAPTURE,micros()-startUs);
     // Data ready!
     captureSemaphore->give();
     return true;
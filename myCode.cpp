@@ -14,6 +14,8 @@
 #include "pinConfiguration.h"
 #include "helpers/helper_pwm.h"
 #include "dso_debug.h"
+#include "dso_static.h"
+#include "DSO_config.h"
 static void MainTask( void *a );
 void splash(void);
 //--
@@ -24,6 +26,14 @@ DSOADC    *adc;
 uint16_t displayIdentifier=0;
 xMutex   *adc2Lock;
 
+// Long lived objects, statically allocated
+static DSOStatic<testSignal> testSignalStorage;
+static DSOStatic<DSOControl> controlStorage;
+static DSOStatic<DSOADC>     adcStorage;
+static DSOStatic<xMutex>     adc2LockStorage;
+DSO_STATIC_TASK(main,DSO_MAIN_TASK_STACK)
+DSO_STATIC_TASK(idle,configMINIMAL_STACK_SIZE)
+
 // Globals
 uint16_t calibrationHash=0;
 
@@ -41,6 +51,7 @@ extern void mainDSOUI(void);
 extern "C" {
 #endif
 void vApplicationDaemonTaskStartupHook(void);
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize );
 #ifdef __cplusplus
 }
 #endif
@@ -66,7 +77,7 @@ void mySetup()
   cpuID::identify(); // enable FPU ASAP
     
   // Ok let's go, switch to FreeRTOS
-  xTaskCreate( MainTask, "MainTask", 350, NULL, DSO_MAIN_TASK_PRIORITY, NULL );   
+  xTaskCreateStatic( MainTask, "MainTask", DSO_MAIN_TASK_STACK, NULL, DSO_MAIN_TASK_PRIORITY, mainStack, &mainTcb );
   vTaskStartScheduler();      
 }
 /**
@@ -75,6 +86,15 @@ void mySetup()
 void vApplicationDaemonTaskStartupHook()
 {
 }
+/**
+ * \brief With static allocation enabled, the kernel asks us for the idle task memory
+ */
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize )
+{
+    *ppxIdleTaskTCBBuffer=&idleTcb;
+    *ppxIdleTaskStackBuffer=idleStack;
+    *pulIdleTaskStackSize=configMINIMAL_STACK_SIZE;
+}
 int adcLockCount=0;
 void useAdc2(bool use)
 {
@@ -92,13 +112,65 @@ void useAdc2(bool use)
         adc2Lock->unlock();
     }
 }
+#define BOOT_PHASES 12
+static const char *bootPhaseName[BOOT_PHASES];
+static uint32_t    bootPhaseTime[BOOT_PHASES];
+static int         nbBootPhases=0;
+/**
+ * \brief Timestamp a boot step, they are logged later as logging itself is slow
+ */
+void bootPhase(const char *name)
+{
+    if(nbBootPhases>=BOOT_PHASES) return;
+    bootPhaseName[nbBootPhases]=name;
+    bootPhaseTime[nbBootPhases++]=millis();
+}
+/**
+ * \brief Dump the boot timeline
+ */
+void bootLog()
+{
+    for(int i=0;i<nbBootPhases;i++)
+        Logger("Boot %s : %d ms\n",bootPhaseName[i],(int)bootPhaseTime[i]);
+    nbBootPhases=0;
+}
+/**
+ * \brief Called by the main UI once its loop is running, start what is not needed
+ * to display the first waveform
+ */
+void bootCompleted()
+{
+    myTestSignal=testSignalStorage.create(  PIN_TEST_SIGNAL,PIN_TEST_SIGNAL_AMP);
+    myTestSignal->setAmplitude(true);
+    myTestSignal->setFrequency(1000); // 1Khz
+    bootPhase("deferred");
+}
+/**
+ * \brief Instead of a fixed delay, make sure the supply is stable : all the multipliers
+ * are derived from VCC
+ */
+static void waitForStableVCC()
+{
+    float last=0;
+    for(int i=0;i<20;i++) // 100 ms max
+    {
+        DSOADC::readVCCmv();
+        float v=DSOADC::getVCCmv();
+        float delta=v-last;
+        if(delta<0) delta=-delta;
+        if(delta*200.<v) // 0.5 %
+            return;
+        last=v;
+        xDelay(5);
+    }
+}
 /**
  * 
  * @param a
  */
 void MainTask( void *a )
 {    
-    
+    bootPhase("scheduler");
     displayIdentifier = tft->readID();
     if(!displayIdentifier) displayIdentifier=0x7789;
     tft=Adafruit_TFTLCD_8bit_STM32::spawn(displayIdentifier);   
@@ -113,42 +185,25 @@ void MainTask( void *a )
     tft->fillScreen(BLACK);
     
     splash();
+    bootPhase("splash");
+    // The splash stays up while we init the hardware, no need to wait
     
-    adc2Lock=new xMutex;
-    
-    delay(500);
-    myTestSignal=new testSignal(  PIN_TEST_SIGNAL,PIN_TEST_SIGNAL_AMP);
-    myTestSignal->setAmplitude(true);
-        
-    myTestSignal->setFrequency(1000); // 1Khz
+    adc2Lock=adc2LockStorage.create();
     
-    controlButtons=new DSOControl ;
+    controlButtons=controlStorage.create();
     
     controlButtons->setup();
     
-    adc=new DSOADC(DSO_INPUT_PIN);
+    adc=adcStorage.create(DSO_INPUT_PIN);
     
-    tft->fillScreen(BLACK);
-    
-    
-    tft->setTextSize(3);
-   
     //DSOCalibrate::calibrate();
     // Start ADC timer timebase at 8 Mhz
     // total period = 0.125 us
     setTimerFrequency(&Timer2,2, 62, 63); 
     //xAssert(0);
     adc->setupADCs ();       
-
-
- // Do a dummy capture to make sure everything is fine
-    
-    adc->setADCPin(PA0);
-    adc->setupDmaSampling();
-    adc->prepareDMASampling(ADC_SMPR_239_5,DSOADC::ADC_PRESCALER_8);    
-    adc->stopDmaCapture();
-
-
+    waitForStableVCC();
+    bootPhase("hardware");
 
     //testCalibrate();
    // testTestSignal();
@@ -164,6 +219,7 @@ void MainTask( void *a )
         DSOCalibrate::zeroCalibrate();         
     }
     DSOEeprom::readFineVoltage();
+    DSOEeprom::readLinearity();
    
     
     //testAdc();   
@@ -173,13 +229,17 @@ void MainTask( void *a )
     // testCalibrate();
     
     DSOInputGain::readCalibrationValue(); // re-read calibration value
-    adc->setupADCs ();
+    bootPhase("calibration");
     
     // --- TEST  ---
     //DSOCalibrate::voltageCalibrate();
     // --- TEST  ---
     
+    // initialize() only creates the capture semaphore & task, it does not touch the ADC.
+    // The ADC is set up for capture by the first setTimeBase (initMainUI), through the initOnce
+    // of the capture table it selects : that's why there is no second setupADCs after zeroCalibrate
     DSOCapture::initialize();
+    bootPhase("capture");
 
     //testI2c();
     mainDSOUI();
@@ -2,56 +2,57 @@ from PyQt5 import uic,QtWidgets,QtCore, QtGui
 from PyQt5.QtCore import *
 from PyQt5.QtGui import *
 from PyQt5.QtWidgets import *
-from DSO150 import DSO150
+from DSO150 import DSO150, Acquisition, SimulatedDSO, DSOError
 import numpy as np
-import cv2 as cv
 
 import sys, time
+#
+# pyDSO.py        : first DSO150 found on USB
+# pyDSO.py --sim  : simulated device
+#
+# The scene is built once, each capture only updates the points of a pre-allocated
+# polygon in place. Captures are streamed by a worker thread, a timer picks the latest one.
+#
+DSO_WIDTH=240
+DSO_HEIGHT=240
+DSO_DIV=24
+REFRESH_MS=15
 
 class Ui(QtWidgets.QMainWindow):
-    scene = None
     scale = 1.0
-    menuVoltage = None
-    menuTimeBase = None
-    menuTrigger = None
-    menuVoltageAg = None
-    buttonSave = None
-    dso = None
-    data = None
-    newCapture = None
-    labelVoltage = None
-    labelTimeBase = None
     voltage = DSO150.DsoVoltage.mV5
     timebase= DSO150.DsoTimeBase.u100
     trigger=  DSO150.DsoTrigger.RISING
     yellow=QColor(qRgb(255,255,0))
-    
-    def alert(self, msg):    
+
+    def alert(self, text):
         msg = QMessageBox()
-        msg.setText(msg)
+        msg.setText(text)
         msg.exec_()
-    
-    def __init__(self):
+
+    def __init__(self,port):
         super(Ui,self).__init__()
         uic.loadUi("ui/dso.ui",self)
         self.gv=  self.findChild(QtWidgets.QGraphicsView, 'graphicsView')
         self.scene = QtWidgets.QGraphicsScene()
         self.gv.setScene(self.scene)
         self.drawGrid()
-        self.dso=DSO150()
+        self.createWaveForm(DSO_WIDTH)
+        self.dso=DSO150(port=port)
+        self.acquisition=Acquisition(self.dso)
         self.voltage=self.dso.GetVoltage()
         self.timebase=self.dso.GetTimeBase()
-        self.trigger=self.dso.GetTrigger()        
-        
-                
+        self.trigger=self.dso.GetTrigger()
+        self.updateScale()
+
         self.menuVoltage=self.findChild(QtWidgets.QMenu, 'menuVoltage')
         self.menuTimeBase=self.findChild(QtWidgets.QMenu, 'menuTimeBase')
         self.menuTrigger=self.findChild(QtWidgets.QMenu, 'menuTrigger')
         self.newCapture=self.findChild(QtWidgets.QPushButton, 'pushButtonReq')
-        self.currentCapture=self.findChild(QtWidgets.QPushButton, 'pushButtonCurrent')
+        self.liveButton=self.findChild(QtWidgets.QPushButton, 'pushButtonCurrent')
         self.buttonSave=self.findChild(QtWidgets.QPushButton, 'pushButtonSave')
-        
-        
+        self.liveButton.setText("Live")
+        self.liveButton.setCheckable(True)
 
         self.labelVoltage=self.findChild(QtWidgets.QLabel, 'labelVoltage')
         self.labelTimeBase=self.findChild(QtWidgets.QLabel, 'labelTimeBase')
@@ -59,128 +60,141 @@ class Ui(QtWidgets.QMainWindow):
         self.labelTimeBase.setText(self.timebase.name)
         self.labelVoltage.setText(self.voltage.name)
 
+        self.menuVoltageAg=self.createMenu(self.menuVoltage,DSO150.DsoVoltage,self.voltage)
+        self.menuTimeBaseAg=self.createMenu(self.menuTimeBase,DSO150.DsoTimeBase,self.timebase)
+        self.menuTriggerAg=self.createMenu(self.menuTrigger,DSO150.DsoTrigger,self.trigger)
 
-        self.menuVoltageAg = QtWidgets.QActionGroup(self.menuVoltage)
-        self.menuVoltageAg.setExclusive(True)
-        for v in DSO150.DsoVoltage:
-            menu = QAction( v.name, self)
-            menu.setCheckable(True)
-            menu.setData(v)
-            if(v==self.voltage):
-                menu.setChecked(True)
-            ma= self.menuVoltageAg.addAction(menu)
-            self.menuVoltage.addAction(ma)
-            
-        
-        
-        self.menuTimeBaseAg = QtWidgets.QActionGroup(self.menuTimeBase)
-        self.menuTimeBaseAg.setExclusive(True)
-        for v in DSO150.DsoTimeBase:
-            menu = QAction( v.name, self)
-            menu.setCheckable(True)
-            if(v==self.timebase):
-                menu.setChecked(True)
-            menu.setData(v)
-            ma= self.menuTimeBaseAg.addAction(menu)
-            self.menuTimeBase.addAction(ma)
-            
-            
-        self.menuTriggerAg = QtWidgets.QActionGroup(self.menuTrigger)
-        self.menuTriggerAg.setExclusive(True)
-        for v in DSO150.DsoTrigger:
-            menu = QAction( v.name, self)
-            menu.setCheckable(True)
-            menu.setData(v)
-            if(v==self.trigger):
-                menu.setChecked(True)
-            ma= self.menuTriggerAg.addAction(menu)
-            self.menuTrigger.addAction(ma)
-            
         self.menuVoltageAg.triggered.connect(self.onVoltageChange)
         self.menuTimeBaseAg.triggered.connect(self.onTimeBaseChange)
         self.menuTriggerAg.triggered.connect(self.onTriggerChange)
         self.newCapture.clicked.connect(self.onNewCapture)
-        self.currentCapture.clicked.connect(self.onCurrentCapture)
+        self.liveButton.toggled.connect(self.onLive)
         self.buttonSave.clicked.connect(self.onSave)
+
+        self.timer=QTimer(self)
+        self.timer.timeout.connect(self.onTimer)
+        self.lastSequence=None
+        self.frames=0
+        self.fpsStart=time.monotonic()
         self.show()
-        
+
+    def createMenu(self,menu,values,current):
+        ag = QtWidgets.QActionGroup(menu)
+        ag.setExclusive(True)
+        for v in values:
+            action = QAction( v.name, self)
+            action.setCheckable(True)
+            action.setData(v)
+            if(v==current):
+                action.setChecked(True)
+            menu.addAction(ag.addAction(action))
+        return ag
+
+    def closeEvent(self,event):
+        self.stopLive()
+        self.dso.close()
+        event.accept()
+
     def onSave(self):
-        yOffset=120
-        img = np.zeros((360+1,320+1+2,3), np.uint8)
-        for x in range(0,240+1,24):
-            cv.line(img,(x,0),(x,240-1),(0,128,0),1)
-        for y in range(0,240+1,24):
-            cv.line(img,(0,y),(240-1,y),(0,128,0),1)
-
-        cv.line(img,(0,yOffset),(240-1,yOffset),(0,255,0),1)
-        cv.line(img,(120,0),(120,240-1),(0,255,0),1)
-        cv.putText(img,self.voltage.name, (240+2,20), cv.FONT_HERSHEY_SIMPLEX, 1, (0,255,0), 2)
-        cv.putText(img,self.timebase.name, (240+2,60), cv.FONT_HERSHEY_SIMPLEX, 1, (0,255,0), 2)
-        l=len(self.data)
-        last=int(self.data[0]*self.scale)
-        for x in range(0,l):
-            y=int(self.data[x]*self.scale)
-            cv.line(img,(x,y+yOffset),(x,last+yOffset),(0,255,255),1)
-            last=y
-        cv.imwrite("output.png",img)
-        #cv.imshow("dso", img)
+        self.gv.grab().save("output.png")
 
     def onNewCapture(self):
-        self.data=self.dso.GetData()
-        self.drawWaveForm(self.data)
-    def onCurrentCapture(self):
-        self.data=self.dso.GetCurrentData()
-        self.drawWaveForm(self.data)
+        self.liveButton.setChecked(False)
+        try:
+            self.drawWaveForm(self.dso.GetData())
+        except DSOError as e:
+            self.alert(str(e))
+    # Live mode
+    def onLive(self,on):
+        if on:
+            self.lastSequence=None
+            self.frames=0
+            self.fpsStart=time.monotonic()
+            self.acquisition.start()
+            self.timer.start(REFRESH_MS)
+        else:
+            self.stopLive()
+    def stopLive(self):
+        self.timer.stop()
+        self.acquisition.stop()
+    def onTimer(self):
+        if self.acquisition.error:
+            self.liveButton.setChecked(False)
+            self.alert(str(self.acquisition.error))
+            return
+        capture=self.acquisition.latest()
+        if capture is None or capture.sequence==self.lastSequence:
+            return
+        self.lastSequence=capture.sequence
+        self.drawWaveForm(capture.volts)
+        self.frames+=1
+        now=time.monotonic()
+        if now-self.fpsStart>=1.:
+            fps=self.frames/(now-self.fpsStart)
+            self.statusBar().showMessage("display %.1f fps, device %.1f capture/s, dropped %d" % (fps,self.acquisition.fps,self.acquisition.dropped))
+            self.frames=0
+            self.fpsStart=now
+    # Settings
     def onTimeBaseChange(self, n):
         v=n.data()
-        print("New timebase "+str(v))
         self.timebase=v
         self.dso.SetTimeBase(v)
         self.labelTimeBase.setText(v.name)
-        pass
     def onTriggerChange(self, n):
         v=n.data()
-        print("New trigger "+str(v))
         self.trigger=v
         self.dso.SetTrigger(v)
-        pass
     def onVoltageChange(self, n):
         v=n.data()
-        print("New voltage "+str(v))
         self.voltage=v
         self.dso.SetVoltage(v)
         self.labelVoltage.setText(v.name)
-        pass
-    
+        self.updateScale()
+    def updateScale(self):
+        volt=self.voltage.asFloat()
+        if volt==0.: # GND
+            volt=1.
+        self.scale=-float(DSO_DIV)/volt
+    # Drawing
     def drawGrid(self):
         black=QColor(qRgb(0,0,0))
         darkGreen=QColor(qRgb(0,128,0))
-        lightGreen=QColor(qRgb(0,255,0))
-        
-        bgnd = QtWidgets.QGraphicsRectItem(QtCore.QRectF(0, 0, 240, 240)) 
+
+        bgnd = QtWidgets.QGraphicsRectItem(QtCore.QRectF(0, 0, DSO_WIDTH, DSO_HEIGHT))
         bgnd.setBrush( black )
         self.scene.addItem(bgnd)
-        for i in range(0,240,24):
-            hline=QLineF(0,i,239,i)
+        for i in range(0,DSO_WIDTH,DSO_DIV):
+            hline=QLineF(0,i,DSO_WIDTH-1,i)
             self.scene.addLine(hline,darkGreen)
-            vline=QLineF(i,0,i,239)
+            vline=QLineF(i,0,i,DSO_HEIGHT-1)
             self.scene.addLine(vline,darkGreen)
-    def volt2pix(self, volt):
-          y=int(volt*self.scale)+120
-          return int(y)
+    def createWaveForm(self,count):
+        """The polygon points are shared with a numpy view, so they can be written in place"""
+        self.polygon=QPolygonF(count)
+        ptr=self.polygon.data()
+        ptr.setsize(count*2*np.dtype(np.float64).itemsize)
+        self.points=np.frombuffer(ptr,dtype=np.float64).reshape(count,2)
+        self.points[:,0]=np.arange(count)
+        self.points[:,1]=DSO_HEIGHT/2
+        if not hasattr(self,'waveItem'):
+            self.waveItem=QGraphicsPathItem()
+            self.waveItem.setPen(QPen(self.yellow))
+            self.scene.addItem(self.waveItem)
     def drawWaveForm(self, data):
-        self.drawGrid()
-        volt=self.dso.GetVoltage().asFloat()
-        self.scale=-24./volt
-        l=len(data)
-        last=self.volt2pix(data[0])
-        for x in range(0,l):
-            y=self.volt2pix(data[x])
-            line=QLineF(x,last,x,y)
-            self.scene.addLine(line,self.yellow)            
-            last=y      
+        if len(data)!=len(self.points):
+            self.createWaveForm(len(data))
+        y=self.points[:,1]
+        np.multiply(data,self.scale,out=y)
+        y+=DSO_HEIGHT/2
+        np.clip(y,0,DSO_HEIGHT-1,out=y)
+        path=QPainterPath()
+        path.addPolygon(self.polygon)
+        self.waveItem.setPath(path)
 
 #
+port=None
+if "--sim" in sys.argv:
+    port=SimulatedDSO()
 app =QtWidgets.QApplication(sys.argv)
-mainWindow=Ui()
+mainWindow=Ui(port)
 app.exec_()
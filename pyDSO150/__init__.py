@@ -0,0 +1,16 @@
+#
+# DSO150 host library
+#
+#   from pyDSO150 import DSO150
+#   dso=DSO150()                        # first DSO found on USB
+#   dso=DSO150(port=SimulatedDSO())     # no hardware
+#   volts=dso.GetData()                 # numpy array
+#   with Acquisition(dso) as acq:       # streaming on a worker thread
+#       capture=acq.wait()
+#
+from .errors import DSOError, DSONotFound, DSOTimeout, DSOProtocolError, DSONack
+from .protocol import DsoArmingMode, DsoTrigger, DsoCommand, DsoTarget, DsoVoltage, DsoTimeBase, DsoReduction, Capture
+from .device import DSO150
+from .acquisition import Acquisition
+from .simulator import SimulatedDSO
+# EOF
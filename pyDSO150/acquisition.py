@@ -0,0 +1,93 @@
+#
+# Background acquisition : streams the captures on a worker thread
+# The consumer either polls latest() (a GUI timer) or gets a callback per capture
+#
+import threading
+import time
+
+from .errors import DSOError, DSOTimeout
+
+class Acquisition(object):
+    def __init__(self,dso,callback=None):
+        self.dso=dso
+        self.callback=callback
+        self.thread=None
+        self.running=False
+        self.error=None
+        self.cond=threading.Condition()
+        self.last=None
+        self.count=0
+        self.fps=0.
+        self.dropped=0
+
+    def start(self):
+        if self.running:
+            return
+        self.running=True
+        self.error=None
+        self.dso.streamSink=self.onCapture
+        self.dso.StartStream()
+        self.thread=threading.Thread(target=self.run,name="DSO150 acquisition",daemon=True)
+        self.thread.start()
+
+    def stop(self):
+        if not self.running:
+            return
+        self.running=False
+        self.thread.join()
+        self.dso.StopStream()
+        self.dso.streamSink=None
+
+    def __enter__(self):
+        self.start()
+        return self
+
+    def __exit__(self,*args):
+        self.stop()
+
+    def run(self):
+        windowStart=time.monotonic()
+        windowCount=0
+        while self.running:
+            try:
+                # short timeout so that stop() is honoured quickly
+                capture=self.dso.ReadStreamCapture(0.2)
+            except DSOTimeout:
+                continue
+            except DSOError as e:
+                self.error=e
+                self.running=False
+                with self.cond:
+                    self.cond.notify_all()
+                return
+            self.onCapture(capture)
+            windowCount+=1
+            now=time.monotonic()
+            if now-windowStart>=1.:
+                self.fps=windowCount/(now-windowStart)
+                windowStart=now
+                windowCount=0
+
+    def onCapture(self,capture):
+        with self.cond:
+            self.last=capture
+            self.count+=1
+            self.dropped=capture.dropped
+            self.cond.notify_all()
+        if self.callback:
+            self.callback(capture)
+
+    def latest(self):
+        """Most recent capture or None, does not block"""
+        with self.cond:
+            return self.last
+
+    def wait(self,timeout=None):
+        """Block until a capture newer than the one already seen is available"""
+        with self.cond:
+            seen=self.count
+            self.cond.wait_for(lambda: self.count!=seen or not self.running,timeout)
+            if self.error:
+                raise self.error
+            return self.last
+# EOF
@@ -0,0 +1,297 @@
+#
+# DSO150 host side driver
+#
+# All the port accesses go through a lock, so the acquisition thread and the caller
+# can share the device. Stream frames received while waiting for a command reply
+# are handed to the stream sink instead of being lost.
+#
+import struct
+import threading
+import time
+
+from .errors import DSOError, DSONotFound, DSOTimeout, DSOProtocolError, DSONack
+from . import protocol
+from .protocol import DsoArmingMode, DsoTrigger, DsoCommand, DsoTarget, DsoVoltage, DsoTimeBase, DsoReduction, Capture
+
+DSO_VID=0x1eaf
+DSO_PID=0x24
+
+def find_port():
+    """Returns the device name of the first DSO150 found"""
+    import serial.tools.list_ports
+    for port in serial.tools.list_ports.comports():
+        if port.vid==DSO_VID and port.pid==DSO_PID:
+            return port.device
+    raise DSONotFound("No DSO found")
+
+class DSO150(object):
+    # Kept here so that DSO150.DsoVoltage etc... still work
+    DsoArmingMode=DsoArmingMode
+    DsoTrigger=DsoTrigger
+    DsoCommand=DsoCommand
+    DsoTarget=DsoTarget
+    DsoVoltage=DsoVoltage
+    DsoTimeBase=DsoTimeBase
+    DsoReduction=DsoReduction
+
+    def __init__(self,port=None,timeout=2.,captureTimeout=10.):
+        """
+        port : None to search the DSO on the USB ports, a device name, or an
+               already opened serial like object (read/write/close), e.g. SimulatedDSO
+        """
+        self.timeout=timeout
+        self.captureTimeout=captureTimeout
+        self.keys=None
+        self.lock=threading.RLock()
+        self.streamSink=None
+        if port is None:
+            port=find_port()
+        if isinstance(port,str):
+            import serial
+            port=serial.Serial(port,115200,timeout=timeout)
+        self.ser=port
+        # Handshake
+        self.ser.write(protocol.HANDSHAKE)
+        handshake=self.ser.read(4)
+        if handshake!=protocol.HANDSHAKE_REPLY:
+            raise DSOProtocolError("Handshake failed, got "+repr(handshake))
+
+    def close(self):
+        self.ser.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self,*args):
+        self.close()
+
+# Low level
+    def readExact(self,n,timeout=None):
+        if timeout is None:
+            timeout=self.timeout
+        deadline=time.monotonic()+timeout
+        buf=b''
+        while len(buf)<n:
+            chunk=self.ser.read(n-len(buf))
+            if chunk:
+                buf+=chunk
+            elif time.monotonic()>deadline:
+                raise DSOTimeout("Timeout, got "+str(len(buf))+" bytes out of "+str(n))
+        return buf
+
+    def readCodes(self,count):
+        header=self.readExact(protocol.DATA_HEADER.size)
+        return Capture.decode(header,self.readExact(2*count))
+
+    def readScreenshot(self):
+        width,height,fmt,marker=protocol.SCREEN_HEADER.unpack(self.readExact(protocol.SCREEN_HEADER.size))
+        if fmt!=protocol.PIXEL_RGB332:
+            raise DSOProtocolError("Unknown pixel format "+str(fmt))
+        data=bytearray()
+        while True:
+            n=self.readExact(1)[0]
+            if not n:
+                break
+            data+=self.readExact(n)
+        try:
+            pixels=protocol.rle_decode(data,width,height,marker)
+        except (ValueError,IndexError) as e:
+            raise DSOProtocolError("Bad screenshot : "+str(e))
+        return protocol.rgb332_to_rgb(pixels)
+
+    def readMessage(self,timeout=None):
+        """
+        Read whatever comes next. Returns (kind, value)
+            ('reply', 4 bytes)   : legacy ACK/NACK
+            ('data', Capture)    : reply to SET DATA
+            ('stream', Capture)  : streamed capture
+            ('screenshot', (h,w,3) RGB array)
+            ('frame', (opcode, payload))
+        """
+        head=self.readExact(4,timeout)
+        if head[0]==protocol.FRAME_SYNC:
+            length=head[3]
+            rest=self.readExact(length+2)
+            payload=rest[:length]
+            crc=struct.unpack('<H',rest[length:])[0]
+            if crc!=protocol.crc16(head[1:]+payload):
+                raise DSOProtocolError("Bad CRC in frame")
+            return 'frame',(head[2],payload)
+        if head[0]==DsoCommand.EVENT.value:
+            count=head[2]*256+head[3]
+            if head[1]==DsoTarget.DATA.value:
+                return 'data',self.readCodes(count)
+            if head[1]==DsoTarget.STREAM.value:
+                sequence,dropped=protocol.STREAM_HEADER.unpack(self.readExact(protocol.STREAM_HEADER.size))
+                capture=self.readCodes(count)
+                capture.streamSequence=sequence
+                capture.dropped=dropped
+                return 'stream',capture
+            if head[1]==DsoTarget.SCREENSHOT.value:
+                return 'screenshot',self.readScreenshot()
+            raise DSOProtocolError("Unknown event "+str(head[1]))
+        if head[0] in (DsoCommand.ACK.value,DsoCommand.NACK.value):
+            return 'reply',head
+        raise DSOProtocolError("Unexpected data "+repr(head))
+
+    def waitFor(self,kind,timeout=None):
+        """Read messages until one of the given kind shows up, streamed captures go to the sink"""
+        while True:
+            k,v=self.readMessage(timeout)
+            if k==kind:
+                return v
+            if k=='stream':
+                if self.streamSink:
+                    self.streamSink(v)
+                continue
+            raise DSOProtocolError("Expected "+kind+", got "+k)
+
+# Legacy commands
+    def sendCommand(self,command,target,value):
+        self.ser.write(protocol.legacy_command(command,target,value))
+
+    def command(self,command,target,value):
+        with self.lock:
+            self.sendCommand(command,target,value)
+            ret=self.waitFor('reply')
+        if ret[0]!=DsoCommand.ACK.value:
+            raise DSONack("Command "+command.name+" to "+target.name+" failed")
+        return ret[2]*256+ret[3]
+
+    def Get(self,target):
+        return self.command(DsoCommand.GET,target,0)
+
+    def Set(self,target,value):
+        self.command(DsoCommand.SET,target,value)
+
+    # Voltage Helper function
+    def SetVoltage(self,value):
+        return self.Set(DsoTarget.VOLTAGE,value.value)
+    def GetVoltage(self):
+        return DsoVoltage(self.Get(DsoTarget.VOLTAGE))
+    # Timebase Helper function
+    def SetTimeBase(self,value):
+        return self.Set(DsoTarget.TIMEBASE,value.value)
+    def GetTimeBase(self):
+        return DsoTimeBase(self.Get(DsoTarget.TIMEBASE))
+    # Trigger Helper function
+    def SetTrigger(self,value):
+        return self.Set(DsoTarget.TRIGGER,value.value)
+    def GetTrigger(self):
+        return DsoTrigger(self.Get(DsoTarget.TRIGGER))
+    # Arming mode
+    def SetArmingMode(self,value):
+        return self.Set(DsoTarget.ARMINGMODE,value.value)
+    def GetArmingMode(self):
+        return DsoArmingMode(self.Get(DsoTarget.ARMINGMODE))
+    # TriggerLevel
+    def SetTriggerLevel(self,value):
+        return self.Set(DsoTarget.TRIGGERLEVEL,int(value*100.)+32768)
+    def GetTriggerLevel(self):
+        return float(self.Get(DsoTarget.TRIGGERLEVEL)-32768)/100.
+
+# Capture
+    def GetCapture(self,wait=0):
+        """Returns a Capture, wait=0 : next capture, wait=1 : the last one"""
+        with self.lock:
+            self.sendCommand(DsoCommand.SET,DsoTarget.DATA,wait)
+            ret=self.waitFor('reply')
+            if ret[0]!=DsoCommand.ACK.value:
+                raise DSONack("Capture request failed")
+            # No trigger => no capture, can be long
+            return self.waitFor('data',self.captureTimeout)
+    def GetRawDataInternal(self,wait):
+        c=self.GetCapture(wait)
+        return c.codes,c.scale,c.offset
+    def GetDataInternal(self,wait):
+        return self.GetCapture(wait).volts
+    # Ask for a new capture, numpy array of volts
+    def GetData(self):
+        return self.GetDataInternal(0)
+    # Returns already captured data
+    def GetCurrentData(self):
+        return self.GetDataInternal(1)
+
+    # Only send samples [start, start+length[ (length=0 : up to the end), each bucket of
+    # decimation samples being reduced to one code (two for MINMAX), applies to captures and streaming
+    def SetWindow(self,start=0,length=0,decimation=1,reduction=DsoReduction.STRIDE):
+        self.SetState({DsoTarget.ROI_START:start,DsoTarget.ROI_LENGTH:length,
+                       DsoTarget.DECIMATION:decimation,DsoTarget.REDUCTION:reduction})
+
+# Screenshot
+    def GetScreenshot(self):
+        """Returns the screen as a (height,width,3) numpy RGB array, 3-3-2 bits deep"""
+        with self.lock:
+            self.sendCommand(DsoCommand.SET,DsoTarget.SCREENSHOT,0)
+            ret=self.waitFor('reply')
+            if ret[0]!=DsoCommand.ACK.value:
+                raise DSONack("Screenshot request failed")
+            return self.waitFor('screenshot',self.captureTimeout)
+    def SaveScreenshot(self,filename):
+        from PIL import Image
+        Image.fromarray(self.GetScreenshot(),'RGB').save(filename)
+
+# Streaming
+    def StartStream(self):
+        self.Set(DsoTarget.STREAM,1)
+    def StopStream(self):
+        # the frames already in flight go to the sink, if any
+        self.Set(DsoTarget.STREAM,0)
+    def ReadStreamCapture(self,timeout=None):
+        with self.lock:
+            return self.waitFor('stream',timeout)
+    def ReadStreamFrame(self):
+        c=self.ReadStreamCapture()
+        return c.streamSequence,c.dropped,c.volts
+
+# Framed protocol
+    def Transact(self,opcode,payload=b''):
+        with self.lock:
+            self.ser.write(protocol.encode_frame(opcode,payload))
+            op,reply=self.waitFor('frame')
+        if op==protocol.FRAME_NACK:
+            raise DSONack("Opcode "+str(opcode)+" rejected",reply[0])
+        if op!=(opcode|protocol.OP_REPLY):
+            raise DSOProtocolError("Reply to "+str(op)+" instead of "+str(opcode))
+        return reply
+    def Caps(self):
+        """Returns protocol version, (fw major, fw minor), max payload and { key : (isFloat, readable, writable)}"""
+        r=self.Transact(protocol.OP_CAPS)
+        keys={}
+        for i in range(0,r[4]):
+            k,t,a=r[5+3*i:8+3*i]
+            keys[k]=(t==protocol.KEY_FLOAT,(a&protocol.KEY_READ)!=0,(a&protocol.KEY_WRITE)!=0)
+        self.keys=keys
+        return r[0],(r[1],r[2]),r[3],keys
+    def isFloat(self,key):
+        if self.keys is None:
+            self.Caps()
+        if key not in self.keys:
+            raise DSOError("Unknown key "+str(key))
+        return self.keys[key][0]
+    def GetState(self,targets=None):
+        """Read several settings in one exchange, all of them if targets is None. Returns { DsoTarget : value }"""
+        payload=b''
+        if targets is not None:
+            payload=bytes([t.value for t in targets])
+        r=self.Transact(protocol.OP_GET,payload)
+        state={}
+        for i in range(0,len(r),5):
+            fmt='<f' if self.isFloat(r[i]) else '<i'
+            state[DsoTarget(r[i])]=struct.unpack(fmt,r[i+1:i+5])[0]
+        return state
+    def SetState(self,state):
+        """Write several settings in one exchange, { DsoTarget : value }. Raises DSONack if one is refused"""
+        payload=b''
+        for target,value in state.items():
+            if hasattr(value,'value'):
+                value=value.value
+            if self.isFloat(target.value):
+                payload+=bytes([target.value])+struct.pack('<f',float(value))
+            else:
+                payload+=bytes([target.value])+struct.pack('<i',int(value))
+        r=self.Transact(protocol.OP_SET,payload)
+        for i in range(0,len(r),2):
+            if r[i+1]:
+                raise DSONack("Setting "+DsoTarget(r[i]).name+" refused",r[i+1])
+# EOF
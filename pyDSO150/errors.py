@@ -0,0 +1,25 @@
+#
+# Exceptions raised by the DSO150 host library
+#
+class DSOError(Exception):
+    """Base class of all the DSO150 errors"""
+    pass
+
+class DSONotFound(DSOError):
+    """No DSO150 on the USB ports"""
+    pass
+
+class DSOTimeout(DSOError):
+    """The device did not answer in time"""
+    pass
+
+class DSOProtocolError(DSOError):
+    """Unexpected or corrupted data from the device"""
+    pass
+
+class DSONack(DSOError):
+    """The device rejected the command"""
+    def __init__(self, message, code=0):
+        super(DSONack,self).__init__(message)
+        self.code=code
+# EOF
@@ -0,0 +1,277 @@
+#
+# Wire format shared with the firmware, see src/dso_usb.h and src/dso_usbCommands.h
+#
+from enum import Enum, unique
+import struct
+import numpy as np
+
+@unique
+class DsoArmingMode(Enum):
+    SINGLE=0
+    MULTI=1
+    CONTINUOUS=2
+
+@unique
+class DsoTrigger(Enum):
+    RISING=0
+    FALLING=1
+    BOTH=2
+    RUN=3
+
+@unique
+class DsoCommand(Enum):
+    GET=1
+    SET=2
+    ACK=3
+    NACK=4
+    EVENT=5
+
+@unique
+class DsoTarget(Enum):
+    VOLTAGE=1
+    TIMEBASE=2
+    TRIGGER=3
+    ARMINGMODE=4
+    DATA=5
+    TRIGGERLEVEL=6
+    STREAM=7
+    OFFSET=8
+    FIRMWARE=10
+    ROI_START=11
+    ROI_LENGTH=12
+    DECIMATION=13
+    REDUCTION=14
+    SCREENSHOT=15
+
+@unique
+class DsoReduction(Enum):
+    STRIDE=0    # first sample of each bucket
+    AVERAGE=1   # average of each bucket
+    MINMAX=2    # min then max of each bucket
+
+@unique
+class DsoVoltage(Enum):
+    GND=0
+    mV5=1
+    mV10=2
+    mV20=3
+    mV50=4
+    mV100=5
+    mV200=6
+    mV500=7
+    V1=8
+    V2=9
+    V5=10
+    def asFloat(self):
+        if(self.name.startswith("G")):
+            return 0.
+        if(self.name.startswith("mV")):
+            v=self.name[2:]
+            return float(v)/1000.
+        return float(self.name[1:])
+
+@unique
+class DsoTimeBase(Enum):
+    u5=0
+    u10=1
+    u25=2
+    u50=3
+    u100=4
+    u200=5
+    u500=6
+    m1=7
+    m2=8
+    m5=9
+    m10=10
+    m20=11
+    m50=12
+    m100=13
+    m200=14
+    m500=15
+    s1=16
+
+# Legacy commands : 4 bytes, type target value16 (big endian)
+def legacy_command(command,target,value):
+    return bytes([command.value, target.value, (value>>8)&0xff, value&0xff])
+
+# Handshake
+HANDSHAKE=b'DSO0'
+HANDSHAKE_REPLY=b'OSD0'
+
+# Framed protocol : SYNC VERSION OPCODE LEN payload CRC16(LE) over VERSION..payload
+FRAME_SYNC=0xA5
+FRAME_VERSION=1
+FRAME_MAX_PAYLOAD=64
+FRAME_NACK=0x7F
+OP_CAPS=1
+OP_GET=2
+OP_SET=3
+OP_REPLY=0x80
+KEY_INT=0
+KEY_FLOAT=1
+KEY_READ=1
+KEY_WRITE=2
+# FRAME_NACK payload
+FRAME_ERROR_VERSION=1
+FRAME_ERROR_LENGTH=2
+FRAME_ERROR_CRC=3
+FRAME_ERROR_OPCODE=4
+FRAME_ERROR_KEY=5
+FRAME_ERROR_BUSY=6   # SET refused while the device UI is in a menu / auto setup
+# OP_SET status, per key
+SET_OK=0
+SET_UNKNOWN_KEY=1
+SET_READ_ONLY=2
+SET_BAD_VALUE=3
+MAX_VOLT=100.   # float keys are refused beyond that
+
+def crc16(data):
+    crc=0xffff
+    for b in data:
+        crc^=b<<8
+        for i in range(0,8):
+            if crc & 0x8000:
+                crc=((crc<<1)^0x1021)&0xffff
+            else:
+                crc=(crc<<1)&0xffff
+    return crc
+
+def encode_frame(opcode,payload=b''):
+    body=bytes([FRAME_VERSION,opcode,len(payload)])+bytes(payload)
+    return bytes([FRAME_SYNC])+body+struct.pack('<H',crc16(body))
+
+# Capture data : after the 4 bytes event,
+#   [stream only] uint32 sequence, uint32 dropped
+#   float scale, uint16 offset, uint16 bits per sample, uint16 start, uint8 stride, uint8 reduction
+#   uint32 capture sequence, uint32 timestamp (ms), float sample interval (s), int16 trigger,
+#   uint16 flags, uint8 timebase, uint8 voltage, uint16 reserved
+#   count x uint16 codes, volt=(code-offset)*scale
+#   bits per sample : 12 for ADC codes, 16 when the device linearity correction is on (1/16 LSB)
+DATA_HEADER=struct.Struct('<fHHHBBIIfhHBBH')
+STREAM_HEADER=struct.Struct('<II')
+CAPTURE_SATURATED=1
+CAPTURE_TRIGGERED=2
+
+class Capture(object):
+    """One waveform as sent by the device, volts and times are computed on demand"""
+    __slots__=('codes','scale','offset','start','stride','reduction','sequence','timestamp','sampleInterval',
+               'trigger','flags','timeBase','voltage','streamSequence','dropped')
+    def __init__(self,codes,scale,offset,start=0,stride=1,reduction=0,sequence=None,timestamp=0,sampleInterval=0.,
+                 trigger=-1,flags=0,timeBase=None,voltage=None,streamSequence=None,dropped=0):
+        self.codes=codes
+        self.scale=scale
+        self.offset=offset
+        self.start=start
+        self.stride=stride
+        self.reduction=DsoReduction(reduction)
+        self.sequence=sequence              # capture number since the device booted
+        self.timestamp=timestamp            # ms since the device booted
+        self.sampleInterval=sampleInterval  # s between two samples of the full capture
+        self.trigger=trigger                # index of the trigger in the full capture, -1 = none
+        self.flags=flags
+        self.timeBase=timeBase
+        self.voltage=voltage
+        self.streamSequence=streamSequence  # streaming only
+        self.dropped=dropped                # streaming only
+    @classmethod
+    def decode(cls,header,raw):
+        """header : DATA_HEADER bytes, raw : the codes"""
+        scale,offset,bits,start,stride,reduction,sequence,timestamp,interval,trigger,flags,timeBase,voltage,_=DATA_HEADER.unpack(header)
+        return cls(decode_codes(raw),scale,offset,start=start,stride=stride,reduction=reduction,sequence=sequence,
+                   timestamp=timestamp,sampleInterval=interval,trigger=trigger,flags=flags,
+                   timeBase=DsoTimeBase(timeBase),voltage=DsoVoltage(voltage))
+    @property
+    def volts(self):
+        return (self.codes.astype(np.float32)-np.float32(self.offset))*np.float32(self.scale)
+    @property
+    def indices(self):
+        """Index in the full capture of the first sample covered by each code"""
+        n=len(self.codes)
+        if self.reduction==DsoReduction.MINMAX:
+            return self.start+(np.arange(n)//2)*self.stride
+        return self.start+np.arange(n)*self.stride
+    @property
+    def time(self):
+        """Time of each code in s, relative to the trigger if any, else to the first sample"""
+        origin=self.trigger if self.triggered else 0
+        return (self.indices-origin)*self.sampleInterval
+    @property
+    def saturated(self):
+        return (self.flags&CAPTURE_SATURATED)!=0
+    @property
+    def triggered(self):
+        return (self.flags&CAPTURE_TRIGGERED)!=0
+    def __len__(self):
+        return len(self.codes)
+
+def reduce_codes(codes,start,length,stride,reduction):
+    """Reference implementation of the firmware window/reduction, on codes"""
+    w=codes[start:start+length] if length else codes[start:]
+    if stride<=1 and reduction!=DsoReduction.MINMAX.value:
+        return w
+    buckets=[w[i:i+stride] for i in range(0,len(w),stride)]
+    if reduction==DsoReduction.STRIDE.value:
+        return np.array([b[0] for b in buckets],dtype='<u2')
+    if reduction==DsoReduction.AVERAGE.value:
+        return np.array([np.round(b.mean()) for b in buckets],dtype='<u2')
+    return np.array([v for b in buckets for v in (b.min(),b.max())],dtype='<u2')
+
+# Screenshot : after the 4 bytes event,
+#   uint16 width, uint16 height, uint8 format, uint8 RLE marker
+#   blocks of (uint8 length, length bytes of RLE), a zero length block ends it
+# RLE : marker value count, anything else is a literal. Runs never span two lines
+SCREEN_HEADER=struct.Struct('<HHBB')
+PIXEL_RGB332=1
+RLE_MARKER=0x76
+
+def rle_encode(pixels,marker=RLE_MARKER):
+    """Reference implementation of the firmware encoder, pixels is a 2D uint8 array"""
+    out=bytearray()
+    for line in pixels:
+        x=0
+        while x<len(line):
+            value=int(line[x])
+            count=1
+            while x+count<len(line) and line[x+count]==value and count<255:
+                count+=1
+            if count>3 or value==marker:
+                out+=bytes([marker,value,count])
+            else:
+                out+=bytes([value])*count
+            x+=count
+    return bytes(out)
+
+def rle_decode(data,width,height,marker=RLE_MARKER):
+    """RLE stream to a (height,width) uint8 array"""
+    out=np.zeros(width*height,dtype=np.uint8)
+    i=0
+    o=0
+    while i<len(data) and o<len(out):
+        value=data[i]
+        count=1
+        i+=1
+        if value==marker:
+            value,count=data[i],data[i+1]
+            i+=2
+        out[o:o+count]=value
+        o+=count
+    if o!=len(out) or i!=len(data):
+        raise ValueError("Screenshot size mismatch")
+    return out.reshape(height,width)
+
+def rgb332_to_rgb(pixels):
+    """(h,w) RGB332 to (h,w,3) 8 bits RGB"""
+    pixels=pixels.astype(np.uint16) # r*255 does not fit in 8 bits
+    r=(pixels>>5)&7
+    g=(pixels>>2)&7
+    b=pixels&3
+    return np.stack([(r*255)//7,(g*255)//7,b*85],axis=-1).astype(np.uint8)
+
+def rgb_to_rgb332(rgb):
+    rgb=rgb.astype(np.uint16)
+    return ((rgb[...,0]&0xE0)|((rgb[...,1]>>3)&0x1C)|(rgb[...,2]>>6)).astype(np.uint8)
+
+def decode_codes(raw):
+    """little endian uint16 buffer to a numpy array, no copy"""
+    return np.frombuffer(raw,dtype='<u2')
+# EOF
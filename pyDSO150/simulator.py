@@ -0,0 +1,277 @@
+#
+# Simulated DSO150 : a serial like object (read/write/close) speaking the firmware protocol
+# Used for development without hardware :
+#       dso=DSO150(port=SimulatedDSO())
+#
+import struct
+import threading
+import time
+import numpy as np
+
+from . import protocol
+from .protocol import DsoCommand, DsoTarget, DsoVoltage, DsoTimeBase, DsoTrigger, DsoArmingMode, DsoReduction
+
+# Same range checks as validSetting in the firmware
+LIMITS={ DsoTarget.VOLTAGE.value : len(DsoVoltage)-1, DsoTarget.TIMEBASE.value : len(DsoTimeBase)-1,
+         DsoTarget.TRIGGER.value : len(DsoTrigger)-1, DsoTarget.ARMINGMODE.value : len(DsoArmingMode)-1,
+         DsoTarget.REDUCTION.value : len(DsoReduction)-1, DsoTarget.DECIMATION.value : 255,
+         DsoTarget.ROI_START.value : 65535, DsoTarget.ROI_LENGTH.value : 65535 }
+
+def valid(target,value):
+    if target==DsoTarget.DECIMATION.value and value<1:
+        return False
+    return target not in LIMITS or 0<=value<=LIMITS[target]
+
+class SimulatedDSO(object):
+    def __init__(self,frequency=1000.,amplitude=1.,noise=0.02,rate=50.,samples=240,timeout=0.5):
+        """
+        frequency, amplitude : the sine wave on the input, in Hz and volt
+        rate                 : captures per second
+        """
+        self.frequency=frequency
+        self.amplitude=amplitude
+        self.noise=noise
+        self.rate=rate
+        self.samples=samples
+        self.timeout=timeout
+        self.scale=1./200.   # volt per code
+        self.offset=2048
+        self.out=bytearray()
+        self.inp=bytearray()
+        self.cond=threading.Condition()
+        self.connected=False
+        self.streaming=False
+        self.sequence=0
+        self.nextCapture=0.
+        self.closed=False
+        self.busy=False     # the UI holds the main loop (menu...) : settings are refused at once
+        self.state={ DsoTarget.VOLTAGE.value : 8, DsoTarget.TIMEBASE.value : 7, DsoTarget.TRIGGER.value : 0,
+                     DsoTarget.ARMINGMODE.value : 2, DsoTarget.TRIGGERLEVEL.value : 32768, DsoTarget.FIRMWARE.value : 0x0100}
+        self.floats={ DsoTarget.TRIGGERLEVEL.value : 0., DsoTarget.OFFSET.value : 0. }
+        for k,v in ((DsoTarget.ROI_START,0),(DsoTarget.ROI_LENGTH,0),(DsoTarget.DECIMATION,1),(DsoTarget.REDUCTION,0)):
+            self.state[k.value]=v
+        self.rng=np.random.default_rng(0)
+        self.captures=0
+        self.boot=time.monotonic()
+
+# serial interface
+    def write(self,data):
+        with self.cond:
+            self.inp+=bytes(data)
+            self.parse()
+            self.cond.notify_all()
+        return len(data)
+
+    def read(self,n=1):
+        deadline=time.monotonic()+self.timeout
+        with self.cond:
+            while len(self.out)<n:
+                if self.streaming:
+                    self.stream()
+                    if len(self.out)>=n:
+                        break
+                remaining=deadline-time.monotonic()
+                if remaining<=0:
+                    break
+                self.cond.wait(min(remaining,0.005))
+            r=bytes(self.out[:n])
+            del self.out[:n]
+            return r
+
+    def close(self):
+        self.closed=True
+
+# waveform
+    def waveform(self):
+        timeDiv=[5e-6,10e-6,25e-6,50e-6,100e-6,200e-6,500e-6,1e-3,2e-3,5e-3,10e-3,20e-3,50e-3,100e-3,200e-3,500e-3,1.][self.state[DsoTarget.TIMEBASE.value]]
+        t=np.arange(self.samples)*(timeDiv/24.)
+        phase=self.rng.uniform(0,2*np.pi)
+        v=self.amplitude*np.sin(2*np.pi*self.frequency*t+phase)+self.rng.normal(0,self.noise,self.samples)
+        codes=np.clip(np.round(v/self.scale)+self.offset,0,4095).astype('<u2')
+        start=min(self.state[DsoTarget.ROI_START.value],self.samples)
+        stride=self.state[DsoTarget.DECIMATION.value]
+        reduction=self.state[DsoTarget.REDUCTION.value]
+        codes=protocol.reduce_codes(codes,start,self.state[DsoTarget.ROI_LENGTH.value],stride,reduction)
+        self.captures+=1
+        flags=protocol.CAPTURE_TRIGGERED
+        if codes.size and (codes.min()==0 or codes.max()==4095):
+            flags|=protocol.CAPTURE_SATURATED
+        header=protocol.DATA_HEADER.pack(self.scale,self.offset,12,start,stride,reduction,self.captures,
+                                         int((time.monotonic()-self.boot)*1000.)&0xffffffff,timeDiv/24.,self.samples//2,flags,
+                                         self.state[DsoTarget.TIMEBASE.value],self.state[DsoTarget.VOLTAGE.value],0)
+        return len(codes),header+codes.tobytes()
+
+    def stream(self):
+        now=time.monotonic()
+        if now<self.nextCapture:
+            return
+        self.nextCapture=now+1./self.rate
+        self.sequence+=1
+        count,data=self.waveform()
+        self.out+=struct.pack('>BBH',DsoCommand.EVENT.value,DsoTarget.STREAM.value,count)
+        self.out+=protocol.STREAM_HEADER.pack(self.sequence,0)
+        self.out+=data
+
+    def screen(self):
+        """Rough look of the device screen : grid and trace, RGB332"""
+        pixels=np.zeros((240,320),dtype=np.uint8)
+        pixels[25:217:24,0:240]=protocol.rgb_to_rgb332(np.array([0,128,0]))
+        pixels[25:217,0:240:24]=protocol.rgb_to_rgb332(np.array([0,128,0]))
+        count,data=self.waveform()
+        codes=np.frombuffer(data[protocol.DATA_HEADER.size:],dtype='<u2')[:240]
+        y=np.clip(121-(codes.astype(np.int32)-self.offset)//10,25,216)
+        pixels[y,np.arange(len(y))]=protocol.rgb_to_rgb332(np.array([255,255,0]))
+        return pixels
+
+    def screenshot(self):
+        pixels=self.screen()
+        rle=protocol.rle_encode(pixels)
+        self.out+=struct.pack('>BBH',DsoCommand.EVENT.value,DsoTarget.SCREENSHOT.value,pixels.shape[0])
+        self.out+=protocol.SCREEN_HEADER.pack(pixels.shape[1],pixels.shape[0],protocol.PIXEL_RGB332,protocol.RLE_MARKER)
+        for i in range(0,len(rle),64):
+            block=rle[i:i+64]
+            self.out+=bytes([len(block)])+block
+        self.out+=b'\x00'
+
+# protocol
+    def reply(self,value=0,ok=True):
+        code=DsoCommand.ACK.value if ok else DsoCommand.NACK.value
+        self.out+=struct.pack('>BBH',code,0,value&0xffff)
+
+    def parse(self):
+        if not self.connected:
+            i=self.inp.find(protocol.HANDSHAKE)
+            if i<0:
+                return
+            del self.inp[:i+4]
+            self.connected=True
+            self.out+=protocol.HANDSHAKE_REPLY
+        while len(self.inp)>=4:
+            if self.inp[0]==protocol.FRAME_SYNC:
+                length=self.inp[3]
+                # checked on the header, like the firmware, the rest of the frame is not waited for
+                if self.inp[1]!=protocol.FRAME_VERSION:
+                    del self.inp[:4]
+                    self.nack(protocol.FRAME_ERROR_VERSION)
+                    continue
+                if length>protocol.FRAME_MAX_PAYLOAD:
+                    del self.inp[:4]
+                    self.nack(protocol.FRAME_ERROR_LENGTH)
+                    continue
+                if len(self.inp)<4+length+2:
+                    return
+                frame=bytes(self.inp[:4+length+2])
+                del self.inp[:4+length+2]
+                self.frame(frame)
+                continue
+            cmd,target,value=struct.unpack('>BBH',bytes(self.inp[:4]))
+            del self.inp[:4]
+            self.legacy(cmd,target,value)
+
+    def legacy(self,cmd,target,value):
+        if cmd==DsoCommand.GET.value:
+            if target==DsoTarget.STREAM.value:
+                self.reply(int(self.streaming))
+            elif target in self.state:
+                self.reply(self.state[target])
+            else:
+                self.reply(ok=False)
+            return
+        if cmd==DsoCommand.SET.value:
+            if self.busy and target!=DsoTarget.SCREENSHOT.value:
+                self.reply(ok=False)
+            elif target==DsoTarget.DATA.value:
+                self.reply()
+                count,data=self.waveform()
+                self.out+=struct.pack('>BBH',DsoCommand.EVENT.value,DsoTarget.DATA.value,count)
+                self.out+=data
+            elif target==DsoTarget.SCREENSHOT.value:
+                self.reply()
+                self.screenshot()
+            elif target==DsoTarget.STREAM.value:
+                self.reply()
+                self.streaming=bool(value)
+                self.sequence=0
+            elif target in self.state and target!=DsoTarget.FIRMWARE.value and valid(target,value):
+                self.state[target]=value
+                if target==DsoTarget.TRIGGERLEVEL.value:
+                    self.floats[target]=(value-32768)/100.
+                self.reply()
+            else:
+                self.reply(ok=False)
+            return
+        self.reply(ok=False)
+
+    keyTable=[(DsoTarget.VOLTAGE.value,protocol.KEY_INT,3),(DsoTarget.TIMEBASE.value,protocol.KEY_INT,3),
+              (DsoTarget.TRIGGER.value,protocol.KEY_INT,3),(DsoTarget.ARMINGMODE.value,protocol.KEY_INT,3),
+              (DsoTarget.TRIGGERLEVEL.value,protocol.KEY_FLOAT,3),(DsoTarget.OFFSET.value,protocol.KEY_FLOAT,3),
+              (DsoTarget.STREAM.value,protocol.KEY_INT,1),(DsoTarget.FIRMWARE.value,protocol.KEY_INT,1),
+              (DsoTarget.ROI_START.value,protocol.KEY_INT,3),(DsoTarget.ROI_LENGTH.value,protocol.KEY_INT,3),
+              (DsoTarget.DECIMATION.value,protocol.KEY_INT,3),(DsoTarget.REDUCTION.value,protocol.KEY_INT,3)]
+
+    def getKey(self,key):
+        if key in self.floats:
+            return struct.pack('<f',self.floats[key])
+        if key==DsoTarget.STREAM.value:
+            return struct.pack('<i',int(self.streaming))
+        return struct.pack('<i',self.state[key])
+
+    def setKey(self,known,k,raw):
+        if k not in known:
+            return protocol.SET_UNKNOWN_KEY
+        if not known[k][2]&protocol.KEY_WRITE:
+            return protocol.SET_READ_ONLY
+        if known[k][1]==protocol.KEY_FLOAT:
+            f=struct.unpack('<f',raw)[0]
+            if not -protocol.MAX_VOLT<=f<=protocol.MAX_VOLT:
+                return protocol.SET_BAD_VALUE
+            self.floats[k]=f
+            if k==DsoTarget.TRIGGERLEVEL.value:
+                self.state[k]=int(f*100)+32768
+            return protocol.SET_OK
+        value=struct.unpack('<i',raw)[0]
+        if not valid(k,value):
+            return protocol.SET_BAD_VALUE
+        self.state[k]=value
+        return protocol.SET_OK
+
+    def nack(self,error):
+        self.out+=protocol.encode_frame(protocol.FRAME_NACK,bytes([error]))
+
+    def frame(self,frame):
+        length=frame[3]
+        payload=frame[4:4+length]
+        if struct.unpack('<H',frame[4+length:])[0]!=protocol.crc16(frame[1:4+length]):
+            self.nack(protocol.FRAME_ERROR_CRC)
+            return
+        op=frame[2]
+        known={k[0]:k for k in self.keyTable}
+        if op==protocol.OP_CAPS:
+            r=bytes([protocol.FRAME_VERSION,1,0,protocol.FRAME_MAX_PAYLOAD,len(self.keyTable)])
+            for k in self.keyTable:
+                r+=bytes(k)
+        elif op==protocol.OP_GET:
+            keys=payload if length else bytes(k[0] for k in self.keyTable)
+            if len(keys)*5>protocol.FRAME_MAX_PAYLOAD:
+                self.nack(protocol.FRAME_ERROR_LENGTH)
+                return
+            if any(k not in known for k in keys):
+                self.nack(protocol.FRAME_ERROR_KEY)
+                return
+            r=b''.join(bytes([k])+self.getKey(k) for k in keys)
+        elif op==protocol.OP_SET:
+            if self.busy:
+                self.nack(protocol.FRAME_ERROR_BUSY)
+                return
+            if length%5:
+                self.nack(protocol.FRAME_ERROR_LENGTH)
+                return
+            r=b''
+            for i in range(0,length,5):
+                k=payload[i]
+                r+=bytes([k,self.setKey(known,k,payload[i+1:i+5])])
+        else:
+            self.nack(protocol.FRAME_ERROR_OPCODE)
+            return
+        self.out+=protocol.encode_frame(op|protocol.OP_REPLY,r)
+# EOF
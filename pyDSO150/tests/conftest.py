@@ -0,0 +1,22 @@
+#
+# pytest setup : the tests import pyDSO150 as a package, from the repository root
+#   python -m pytest pyDSO150/tests
+#
+import os
+import sys
+
+import pytest
+
+sys.path.insert(0,os.path.join(os.path.dirname(__file__),'..','..'))
+
+from pyDSO150 import DSO150, SimulatedDSO
+
+@pytest.fixture
+def sim():
+    return SimulatedDSO(rate=200.)
+
+@pytest.fixture
+def dso(sim):
+    with DSO150(port=sim,timeout=1.) as d:
+        yield d
+# EOF
@@ -0,0 +1,90 @@
+#
+# Wire format helpers : crc, framing, RLE, window reduction
+#
+import struct
+
+import numpy as np
+import pytest
+
+from pyDSO150 import protocol
+from pyDSO150.protocol import DsoCommand, DsoTarget, DsoReduction
+
+def test_crc16_ccitt():
+    # CRC-16/CCITT-FALSE check value, same as crc16() in src/dso_usb.cpp
+    assert protocol.crc16(b'123456789')==0x29B1
+    assert protocol.crc16(b'')==0xFFFF
+
+def test_encode_frame_layout():
+    f=protocol.encode_frame(protocol.OP_GET,bytes([1,2]))
+    assert f[0]==protocol.FRAME_SYNC
+    assert f[1]==protocol.FRAME_VERSION
+    assert f[2]==protocol.OP_GET
+    assert f[3]==2
+    assert f[4:6]==bytes([1,2])
+    assert struct.unpack('<H',f[6:])[0]==protocol.crc16(f[1:6])
+
+def test_encode_frame_empty():
+    f=protocol.encode_frame(protocol.OP_CAPS)
+    assert len(f)==6
+    assert f[3]==0
+
+def test_legacy_command():
+    assert protocol.legacy_command(DsoCommand.SET,DsoTarget.TRIGGERLEVEL,0x8123)==bytes([2,6,0x81,0x23])
+
+def rle_roundtrip(pixels):
+    data=protocol.rle_encode(pixels)
+    out=protocol.rle_decode(data,pixels.shape[1],pixels.shape[0])
+    assert np.array_equal(out,pixels)
+    return data
+
+def test_rle_runs():
+    pixels=np.zeros((2,320),dtype=np.uint8)
+    data=rle_roundtrip(pixels)
+    # 320 = 255+65 per line, runs never span two lines
+    assert data==bytes([protocol.RLE_MARKER,0,255,protocol.RLE_MARKER,0,65])*2
+
+def test_rle_literals_and_marker():
+    line=np.array([[1,2,2,3,3,3,protocol.RLE_MARKER,4,4,4,4]],dtype=np.uint8)
+    data=rle_roundtrip(line)
+    # short runs stay literal, the marker value is always escaped
+    assert data==bytes([1,2,2,3,3,3,protocol.RLE_MARKER,protocol.RLE_MARKER,1,protocol.RLE_MARKER,4,4])
+
+def test_rle_random():
+    rng=np.random.default_rng(1)
+    pixels=rng.integers(0,4,(20,64)).astype(np.uint8)*protocol.RLE_MARKER//3
+    rle_roundtrip(pixels)
+
+def test_rle_decode_size_mismatch():
+    data=protocol.rle_encode(np.zeros((2,10),dtype=np.uint8))
+    with pytest.raises(ValueError):
+        protocol.rle_decode(data,10,3)
+    with pytest.raises(ValueError):
+        protocol.rle_decode(data+b'\x01',10,2)
+
+def test_rgb332():
+    rgb=np.array([[[255,255,255],[0,0,0],[255,0,0]]],dtype=np.uint8)
+    p=protocol.rgb_to_rgb332(rgb)
+    assert list(p[0])==[0xFF,0,0xE0]
+    assert np.array_equal(protocol.rgb332_to_rgb(p),rgb)
+
+def test_reduce_codes():
+    codes=np.arange(10,dtype='<u2')
+    assert list(protocol.reduce_codes(codes,0,0,1,DsoReduction.STRIDE.value))==list(range(10))
+    assert list(protocol.reduce_codes(codes,2,6,1,DsoReduction.STRIDE.value))==[2,3,4,5,6,7]
+    assert list(protocol.reduce_codes(codes,0,0,3,DsoReduction.STRIDE.value))==[0,3,6,9]
+    assert list(protocol.reduce_codes(codes,0,0,2,DsoReduction.AVERAGE.value))==[0,2,4,6,8] # round half to even
+    assert list(protocol.reduce_codes(codes,0,0,4,DsoReduction.MINMAX.value))==[0,3,4,7,8,9]
+
+def test_capture_decode():
+    header=protocol.DATA_HEADER.pack(0.01,2048,12,4,2,DsoReduction.STRIDE.value,7,1234,1e-6,10,
+                                     protocol.CAPTURE_TRIGGERED,3,8,0)
+    codes=np.array([2048,2148,1948],dtype='<u2')
+    c=protocol.Capture.decode(header,codes.tobytes())
+    assert c.sequence==7
+    assert c.timestamp==1234
+    assert c.triggered and not c.saturated
+    assert np.allclose(c.volts,[0.,1.,-1.])
+    assert list(c.indices)==[4,6,8]
+    assert np.allclose(c.time,[-6e-6,-4e-6,-2e-6])
+    assert len(c)==3
+# EOF
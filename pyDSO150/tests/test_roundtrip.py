@@ -0,0 +1,56 @@
+#
+# Command round trip time, the scripted version of pyUsb/pySerial_rtt.py
+# Against the simulator this checks the host side overhead and that a busy device
+# answers at once instead of holding the commands
+#
+import time
+
+import pytest
+
+from pyDSO150 import protocol, DSONack
+from pyDSO150.protocol import DsoTarget, DsoTimeBase
+
+RTT_MAX_MS=20.
+
+def rtt(fn,nb=100):
+    times=[]
+    for i in range(nb):
+        start=time.perf_counter()
+        fn()
+        times.append((time.perf_counter()-start)*1000.)
+    times.sort()
+    return times[len(times)//2],times[-1]
+
+def test_rtt_legacy(dso):
+    median,worst=rtt(lambda: dso.Get(DsoTarget.FIRMWARE))
+    assert worst<RTT_MAX_MS
+
+def test_rtt_framed(dso):
+    median,worst=rtt(lambda: dso.GetState([DsoTarget.TIMEBASE]))
+    assert worst<RTT_MAX_MS
+
+def test_rtt_while_streaming(dso):
+    dso.streamSink=lambda c: None
+    dso.StartStream()
+    median,worst=rtt(lambda: dso.Get(DsoTarget.FIRMWARE),20)
+    dso.StopStream()
+    assert median<RTT_MAX_MS
+
+def test_busy(dso,sim):
+    sim.busy=True
+    # reads are still answered
+    assert dso.GetTimeBase()==DsoTimeBase.m1
+    # settings are refused at once, not queued
+    start=time.perf_counter()
+    with pytest.raises(DSONack):
+        dso.SetTimeBase(DsoTimeBase.u50)
+    with pytest.raises(DSONack) as e:
+        dso.SetState({DsoTarget.TIMEBASE:DsoTimeBase.u50})
+    assert e.value.code==protocol.FRAME_ERROR_BUSY
+    assert (time.perf_counter()-start)*1000.<2*RTT_MAX_MS
+    # screenshots are still served, e.g. to document a menu
+    assert dso.GetScreenshot().shape==(240,320,3)
+    sim.busy=False
+    dso.SetTimeBase(DsoTimeBase.u50)
+    assert dso.GetTimeBase()==DsoTimeBase.u50
+# EOF
@@ -0,0 +1,41 @@
+#
+# Screenshot : RLE readback, RGB332 expansion and PNG save against a stored reference
+# The reference is the simulated screen (grid + 1 kHz sine, no noise), to regenerate it :
+#   DSO_UPDATE_REFERENCE=1 python -m pytest pyDSO150/tests/test_screenshot.py
+#
+import os
+
+import numpy as np
+import pytest
+
+from PIL import Image
+
+from pyDSO150 import DSO150, SimulatedDSO, protocol
+
+REFERENCE=os.path.join(os.path.dirname(__file__),'data','screenshot.png')
+
+@pytest.fixture
+def quiet():
+    with DSO150(port=SimulatedDSO(noise=0.),timeout=1.) as d:
+        yield d
+
+def reference():
+    return np.array(Image.open(REFERENCE).convert('RGB'))
+
+def test_matches_reference(quiet):
+    shot=quiet.GetScreenshot()
+    if os.environ.get('DSO_UPDATE_REFERENCE'):
+        Image.fromarray(shot,'RGB').save(REFERENCE)
+    assert shot.shape==(240,320,3)
+    assert np.array_equal(shot,reference())
+
+def test_save(quiet,tmp_path):
+    name=str(tmp_path/'shot.png')
+    quiet.SaveScreenshot(name)
+    assert np.array_equal(np.array(Image.open(name).convert('RGB')),reference())
+
+def test_reference_compresses():
+    # mostly black and grid : the RLE stream is a small fraction of the raw RGB332 screen
+    pixels=protocol.rgb_to_rgb332(reference())
+    assert len(protocol.rle_encode(pixels))<pixels.size//8
+# EOF
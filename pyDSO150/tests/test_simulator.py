@@ -0,0 +1,184 @@
+#
+# DSO150 driver against the simulated device : handshake, framed GET/SET/CAPS,
+# frame errors, legacy commands, captures, screenshot and streaming
+#
+import struct
+
+import numpy as np
+import pytest
+
+from pyDSO150 import protocol, DSO150, SimulatedDSO, Acquisition, DSONack, DSOProtocolError
+from pyDSO150.protocol import DsoTarget, DsoVoltage, DsoTimeBase, DsoTrigger, DsoReduction
+
+def raw_frame(dso,data):
+    """Send raw bytes, return the (opcode,payload) of the frame that comes back"""
+    dso.ser.write(data)
+    return dso.waitFor('frame')
+
+def test_handshake_fails_on_garbage():
+    class Mute(object):
+        def write(self,data): return len(data)
+        def read(self,n=1): return b'XXXX'[:n]
+        def close(self): pass
+    with pytest.raises(DSOProtocolError):
+        DSO150(port=Mute())
+
+def test_caps(dso,sim):
+    version,fw,maxPayload,keys=dso.Caps()
+    assert version==protocol.FRAME_VERSION
+    assert fw==(1,0)
+    assert maxPayload==protocol.FRAME_MAX_PAYLOAD
+    assert len(keys)==len(sim.keyTable)
+    assert keys[DsoTarget.TRIGGERLEVEL.value]==(True,True,True)
+    assert keys[DsoTarget.FIRMWARE.value]==(False,True,False)
+    assert keys[DsoTarget.VOLTAGE.value]==(False,True,True)
+
+def test_get_all(dso):
+    state=dso.GetState()
+    assert state[DsoTarget.VOLTAGE]==DsoVoltage.V1.value
+    assert state[DsoTarget.TIMEBASE]==DsoTimeBase.m1.value
+    assert state[DsoTarget.STREAM]==0
+    assert state[DsoTarget.DECIMATION]==1
+    assert state[DsoTarget.OFFSET]==0.
+
+def test_get_subset(dso):
+    state=dso.GetState([DsoTarget.TIMEBASE,DsoTarget.VOLTAGE])
+    assert list(state.keys())==[DsoTarget.TIMEBASE,DsoTarget.VOLTAGE]
+
+def test_set_then_get(dso):
+    dso.SetState({DsoTarget.VOLTAGE:DsoVoltage.mV200,DsoTarget.TRIGGERLEVEL:1.25,DsoTarget.TRIGGER:DsoTrigger.FALLING})
+    state=dso.GetState([DsoTarget.VOLTAGE,DsoTarget.TRIGGERLEVEL,DsoTarget.TRIGGER])
+    assert state[DsoTarget.VOLTAGE]==DsoVoltage.mV200.value
+    assert state[DsoTarget.TRIGGERLEVEL]==pytest.approx(1.25)
+    assert state[DsoTarget.TRIGGER]==DsoTrigger.FALLING.value
+    # the legacy view of the same settings
+    assert dso.GetVoltage()==DsoVoltage.mV200
+    assert dso.GetTriggerLevel()==pytest.approx(1.25)
+
+def set_status(dso,key,raw):
+    r=dso.Transact(protocol.OP_SET,bytes([key])+raw)
+    assert r[0]==key
+    return r[1]
+
+def test_set_status(dso):
+    assert set_status(dso,DsoTarget.TIMEBASE.value,struct.pack('<i',3))==protocol.SET_OK
+    assert set_status(dso,DsoTarget.FIRMWARE.value,struct.pack('<i',3))==protocol.SET_READ_ONLY
+    assert set_status(dso,99,struct.pack('<i',3))==protocol.SET_UNKNOWN_KEY
+    assert set_status(dso,DsoTarget.VOLTAGE.value,struct.pack('<i',len(DsoVoltage)))==protocol.SET_BAD_VALUE
+    assert set_status(dso,DsoTarget.VOLTAGE.value,struct.pack('<i',-1))==protocol.SET_BAD_VALUE
+    assert set_status(dso,DsoTarget.DECIMATION.value,struct.pack('<i',0))==protocol.SET_BAD_VALUE
+    assert set_status(dso,DsoTarget.OFFSET.value,struct.pack('<f',1e6))==protocol.SET_BAD_VALUE
+    assert set_status(dso,DsoTarget.OFFSET.value,struct.pack('<f',float('nan')))==protocol.SET_BAD_VALUE
+    # refused values are not applied
+    assert dso.GetState([DsoTarget.TIMEBASE,DsoTarget.OFFSET])=={DsoTarget.TIMEBASE:3,DsoTarget.OFFSET:0.}
+
+def test_set_refused_raises(dso):
+    with pytest.raises(DSONack) as e:
+        dso.SetState({DsoTarget.FIRMWARE:2})
+    assert e.value.code==protocol.SET_READ_ONLY
+
+def test_bad_crc(dso):
+    f=bytearray(protocol.encode_frame(protocol.OP_CAPS))
+    f[-1]^=0x55
+    assert raw_frame(dso,bytes(f))==(protocol.FRAME_NACK,bytes([protocol.FRAME_ERROR_CRC]))
+    # the link is still usable
+    assert dso.Caps()[0]==protocol.FRAME_VERSION
+
+def test_corrupted_payload(dso):
+    f=bytearray(protocol.encode_frame(protocol.OP_GET,bytes([DsoTarget.VOLTAGE.value])))
+    f[4]=DsoTarget.TIMEBASE.value
+    assert raw_frame(dso,bytes(f))==(protocol.FRAME_NACK,bytes([protocol.FRAME_ERROR_CRC]))
+
+def test_frame_errors(dso):
+    with pytest.raises(DSONack) as e:
+        dso.Transact(0x42)
+    assert e.value.code==protocol.FRAME_ERROR_OPCODE
+    with pytest.raises(DSONack) as e:
+        dso.Transact(protocol.OP_GET,bytes([99]))
+    assert e.value.code==protocol.FRAME_ERROR_KEY
+    with pytest.raises(DSONack) as e:
+        dso.Transact(protocol.OP_GET,bytes([DsoTarget.VOLTAGE.value]*13))
+    assert e.value.code==protocol.FRAME_ERROR_LENGTH
+    with pytest.raises(DSONack) as e:
+        dso.Transact(protocol.OP_SET,bytes([DsoTarget.VOLTAGE.value,1,0,0]))
+    assert e.value.code==protocol.FRAME_ERROR_LENGTH
+
+def test_header_errors(dso):
+    # rejected on the header alone, without waiting for the rest
+    assert raw_frame(dso,bytes([protocol.FRAME_SYNC,2,protocol.OP_CAPS,0]))==(protocol.FRAME_NACK,bytes([protocol.FRAME_ERROR_VERSION]))
+    assert raw_frame(dso,bytes([protocol.FRAME_SYNC,1,protocol.OP_SET,protocol.FRAME_MAX_PAYLOAD+1]))==(protocol.FRAME_NACK,bytes([protocol.FRAME_ERROR_LENGTH]))
+    assert dso.Caps()[0]==protocol.FRAME_VERSION
+
+def test_legacy(dso):
+    dso.SetTimeBase(DsoTimeBase.u50)
+    assert dso.GetTimeBase()==DsoTimeBase.u50
+    dso.SetTrigger(DsoTrigger.BOTH)
+    assert dso.GetTrigger()==DsoTrigger.BOTH
+    with pytest.raises(DSONack):
+        dso.Set(DsoTarget.FIRMWARE,3)
+    with pytest.raises(DSONack):
+        dso.Set(DsoTarget.TIMEBASE,len(DsoTimeBase))
+    assert dso.GetTimeBase()==DsoTimeBase.u50
+
+def test_capture(dso,sim):
+    c=dso.GetCapture()
+    assert len(c)==sim.samples
+    assert c.offset==sim.offset
+    assert c.triggered
+    assert c.timeBase==DsoTimeBase.m1
+    assert c.voltage==DsoVoltage.V1
+    assert np.abs(c.volts).max()==pytest.approx(sim.amplitude,abs=0.15)
+
+def test_capture_window(dso,sim):
+    dso.SetWindow(start=40,length=100,decimation=4,reduction=DsoReduction.MINMAX)
+    c=dso.GetCapture()
+    assert len(c)==2*25
+    assert c.reduction==DsoReduction.MINMAX
+    assert list(c.indices[:4])==[40,40,44,44]
+    assert np.all(c.codes[0::2]<=c.codes[1::2])
+
+def test_screenshot(dso):
+    rgb=dso.GetScreenshot()
+    assert rgb.shape==(240,320,3)
+    # the trace is yellow
+    assert np.any(np.all(rgb==[255,255,0],axis=-1))
+
+def test_stream(dso):
+    dso.StartStream()
+    assert dso.Get(DsoTarget.STREAM)==1
+    seqs=[]
+    for i in range(5):
+        c=dso.ReadStreamCapture(1.)
+        seqs.append(c.streamSequence)
+        assert c.dropped==0
+        assert len(c)==240
+    assert seqs==list(range(1,6))
+    # frames still in flight when stopping go to the sink
+    sunk=[]
+    dso.streamSink=sunk.append
+    dso.StopStream()
+    assert dso.Get(DsoTarget.STREAM)==0
+    assert all(c.streamSequence>5 for c in sunk)
+
+def test_command_while_streaming(dso):
+    # a command reply interleaved with stream frames : the frames are not lost
+    sunk=[]
+    dso.streamSink=sunk.append
+    dso.StartStream()
+    dso.ReadStreamCapture(1.)
+    for i in range(5):
+        assert dso.GetState([DsoTarget.STREAM])[DsoTarget.STREAM]==1
+    dso.StopStream()
+    seqs=[c.streamSequence for c in sunk]
+    assert seqs==sorted(seqs)
+
+def test_acquisition(dso):
+    with Acquisition(dso) as acq:
+        first=acq.wait(1.)
+        second=acq.wait(1.)
+        assert first is not None and second is not None
+        assert second.streamSequence>first.streamSequence
+        assert acq.latest() is not None
+    assert acq.error is None
+    assert dso.Get(DsoTarget.STREAM)==0
+# EOF
@@ -1,17 +1,41 @@
 from DSO150 import DSO150
 import csv
+import sys
 import time
+#
+# pySerial_capture.py              : one capture to output.csv, time relative to the trigger
+# pySerial_capture.py stream [n]   : stream n captures (default 100) to stream.csv
+#                                    one line per capture : sequence, dropped, samples...
+#
 dso=DSO150()
 
+if len(sys.argv)>1 and sys.argv[1]=="stream":
+    nb=100
+    if len(sys.argv)>2:
+        nb=int(sys.argv[2])
+    print("Streaming "+str(nb)+" captures ")
+    f = open('stream.csv', 'w')
+    writer = csv.writer(f)
+    writer.writerow(['seq','dropped','v...'])
+    dso.StartStream()
+    start=time.time()
+    dropped=0
+    for i in range(0,nb):
+        sequence,dropped,data=dso.ReadStreamFrame()
+        writer.writerow([sequence,dropped]+list(data))
+    dso.StopStream()
+    elapsed=time.time()-start
+    f.close()
+    print("Received "+str(nb)+" captures in "+str(int(elapsed*1000))+" ms, device dropped "+str(dropped))
+    exit(0)
+
 print("Asking for a capture ")
-data=dso.GetData() 
+capture=dso.GetCapture()
+print("Capture #"+str(capture.sequence)+" at "+str(capture.timestamp)+" ms, "+str(capture.sampleInterval*1e6)+" us/sample"
+      +(", saturated" if capture.saturated else "")+("" if capture.triggered else ", not triggered"))
 f = open('output.csv', 'w')
 writer = csv.writer(f)
 writer.writerow(['t','v'])
-l=len(data)
-for i in range(0,l):
-    ns=[i, float(data[i])]
-    print(ns)
-    writer.writerow(ns) 
-f.close()    
-
+for t,v in zip(capture.time,capture.volts):
+    writer.writerow([float(t), float(v)])
+f.close()
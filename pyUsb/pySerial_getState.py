@@ -0,0 +1,11 @@
+from DSO150 import DSO150
+#
+# Dump the capabilities and the whole scope state using the framed protocol, 2 round trips
+#
+dso=DSO150()
+
+version,fw,maxPayload,keys=dso.Caps()
+print("Protocol v"+str(version)+", firmware "+str(fw[0])+"."+str(fw[1])+", max payload "+str(maxPayload))
+for target,value in dso.GetState().items():
+    print(target.name+" : "+str(value))
+dso.close()
@@ -0,0 +1,18 @@
+from DSO150 import DSO150
+import sys
+import time
+#
+# Measure the command round trip time : GET FIRMWARE n times (default 100)
+#
+dso=DSO150()
+nb=100
+if len(sys.argv)>1:
+    nb=int(sys.argv[1])
+rtt=[]
+for i in range(0,nb):
+    start=time.perf_counter()
+    dso.Get(dso.DsoTarget.FIRMWARE)
+    rtt.append((time.perf_counter()-start)*1000.)
+rtt.sort()
+print("Round trip over "+str(nb)+" commands (ms) : min %.2f median %.2f max %.2f" % (rtt[0],rtt[len(rtt)//2],rtt[-1]))
+dso.close()
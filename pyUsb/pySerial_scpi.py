@@ -0,0 +1,39 @@
+import DSO150 # sets the path to pyDSO150
+from pyDSO150 import protocol
+from pyDSO150.device import find_port
+import serial
+import sys
+#
+# Talk SCPI to the DSO, no handshake needed
+#   pySerial_scpi.py                       : *IDN? and the current settings
+#   pySerial_scpi.py ":TIM:SCAL 1e-3" ...  : send the given commands, queries are answered
+#
+def readLine(ser):
+    line=ser.readline()
+    if not line.endswith(b'\n'):
+        raise RuntimeError("Timeout")
+    return line.decode().strip()
+
+def readBlock(ser):
+    """#<n><length><data>\\n, data = data header + codes"""
+    if ser.read(1)!=b'#':
+        raise RuntimeError("Not a block")
+    n=int(ser.read(1))
+    length=int(ser.read(n))
+    data=ser.read(length+1)[:length]
+    return protocol.Capture.decode(data[:protocol.DATA_HEADER.size],data[protocol.DATA_HEADER.size:])
+
+ser=serial.Serial(find_port(),115200,timeout=2)
+commands=sys.argv[1:]
+if not commands:
+    commands=["*IDN?",":TIMebase:SCALe?",":CHANnel1:SCALe?",":TRIGger:LEVel?",":WAVeform:DATA?",":SYSTem:ERRor?"]
+for c in commands:
+    ser.write((c+"\n").encode())
+    if not c.endswith("?"):
+        continue
+    if c.upper().startswith(":WAV"):
+        capture=readBlock(ser)
+        print(c+" : "+str(len(capture))+" samples, "+str(capture.volts.min())+" .. "+str(capture.volts.max())+" V")
+    else:
+        print(c+" : "+readLine(ser))
+ser.close()
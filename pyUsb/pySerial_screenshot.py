@@ -0,0 +1,16 @@
+from DSO150 import DSO150
+import sys
+#
+# Save the DSO screen as an image
+#   pySerial_screenshot.py [file, default screenshot.png] [--sim]
+#
+port=None
+args=[a for a in sys.argv[1:] if a!="--sim"]
+if "--sim" in sys.argv:
+    from DSO150 import SimulatedDSO
+    port=SimulatedDSO()
+filename=args[0] if args else "screenshot.png"
+dso=DSO150(port=port)
+dso.SaveScreenshot(filename)
+print("Saved "+filename)
+dso.close()
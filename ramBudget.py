@@ -0,0 +1,63 @@
+#
+# RAM budget report, run after the link
+#   ramBudget.py <size tool> <firmware.elf> [--ram bytes] <lib1.a> <lib2.a> ...
+#
+# Lists .data+.bss per translation unit found in the libraries, the subtotal per library
+# and what is left for the rest (core, firmware sources). Everything long lived is statically
+# allocated, so this is the real RAM footprint, the FreeRTOS heap being one of the entries.
+# With --ram, the build fails if the firmware uses more than that.
+#
+import subprocess
+import sys
+import os
+
+def sizes(tool,path):
+    """Returns [(module, data, bss)] from berkeley size output"""
+    out=subprocess.check_output([tool,path]).decode()
+    result=[]
+    for line in out.splitlines()[1:]:
+        f=line.split(None,5)
+        if len(f)<6:
+            continue
+        name=f[5].split(' (ex ')[0]
+        result.append((os.path.basename(name),int(f[1]),int(f[2])))
+    return result
+
+if len(sys.argv)<3:
+    print("usage : ramBudget.py <size tool> <firmware.elf> [--ram bytes] [libs...]")
+    sys.exit(1)
+tool=sys.argv[1]
+elf=sys.argv[2]
+args=sys.argv[3:]
+ram=0
+if len(args)>=2 and args[0]=='--ram':
+    ram=int(args[1])
+    args=args[2:]
+
+modules=[]
+libTotals=[]
+for lib in args:
+    entries=[e for e in sizes(tool,lib) if e[1]+e[2]]
+    modules+=[(os.path.basename(lib),)+e for e in entries]
+    libTotals.append((os.path.basename(lib),sum(e[1]+e[2] for e in entries)))
+
+_,data,bss=sizes(tool,elf)[0]
+total=data+bss
+
+print("---- RAM budget ----")
+print("%-28s %-28s %7s %7s %7s" % ("library","module","data","bss","total"))
+for lib,name,d,b in sorted(modules,key=lambda m:-(m[2]+m[3])):
+    print("%-28s %-28s %7d %7d %7d" % (lib,name,d,b,d+b))
+print("--")
+accounted=0
+for lib,t in sorted(libTotals,key=lambda l:-l[1]):
+    print("%-57s %23d" % (lib,t))
+    accounted+=t
+print("%-57s %23d" % ("others (core, firmware sources)",total-accounted))
+print("%-57s %23d" % ("firmware (data+bss)",total))
+if ram:
+    print("%-57s %22d%%" % ("of the RAM",(100*total)//ram))
+    if total>ram:
+        print("RAM budget exceeded : "+str(total)+" > "+str(ram))
+        sys.exit(1)
+# EOF
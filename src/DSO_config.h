@@ -5,4 +5,13 @@
 #define DSO_MAIN_TASK_PRIORITY 10
 #define DSO_CONTROL_TASK_PRIORITY 15
 #define DSO_CAPTURE_TASK_PRIORITY 20
+#define DSO_RENDER_TASK_PRIORITY 5 // below main, drawing must not delay capture & buttons
+
+// Task stacks, in words, they are statically allocated
+#define DSO_MAIN_TASK_STACK     350
+#define DSO_CONTROL_TASK_STACK  250
+#define DSO_CAPTURE_TASK_STACK  200
+#define DSO_RENDER_TASK_STACK   256
+#define DSO_USB_TASK_STACK      200 // this one still comes from the FreeRTOS heap (xTask)
+#define DSO_STACK_MARGIN        32  // words, a task with less than that left is reported
 
@@ -46,12 +46,26 @@ uint16_t calibrationAC[  DSO_NB_GAIN_RANGES+1];
 float    voltageFineTune[DSO_NB_GAIN_RANGES+1];
 float    multipliers[    DSO_NB_GAIN_RANGES+1];
 float    raw_multipliers[    DSO_NB_GAIN_RANGES+1];
+int16_t  linearity[DSO_NB_GAIN_RANGES][LINEARITY_KNOTS];
+static const int16_t *currentLinearity=NULL;
+
+/**
+ * \brief NULL if the table is all zero, so that the conversion can skip it
+ */
+static const int16_t *linearityOf(int range)
+{
+    for(int i=0;i<LINEARITY_KNOTS;i++)
+        if(linearity[range][i])
+            return linearity[range];
+    return NULL;
+}
 
 /**
  */
 bool DSOInputGain::setGainRange(DSOInputGain::InputGainRange range)
 {
     currentRange=range;
+    currentLinearity=linearityOf((int)range);
     controlButtons->setInputGain(gainMapping[(int)range]);
     return true;
 }
@@ -81,6 +95,49 @@ float                        DSOInputGain::getMultiplier()
     return multipliers[(int)currentRange];
 }
 
+/**
+ * 
+ * @return the correction table of the current range, NULL if none
+ */
+const int16_t               *DSOInputGain::getLinearity()
+{
+    return currentLinearity;
+}
+/**
+ * \brief Raw table, for the eeprom
+ */
+int16_t                     *DSOInputGain::getLinearityTable(int range)
+{
+    xAssert(range>=0 && range<DSO_NB_GAIN_RANGES);
+    return linearity[range];
+}
+/**
+ * 
+ * @param range
+ */
+void                         DSOInputGain::clearLinearity(int range)
+{
+    xAssert(range>=0 && range<DSO_NB_GAIN_RANGES);
+    for(int i=0;i<LINEARITY_KNOTS;i++)
+        linearity[range][i]=0;
+    if(range==(int)currentRange)
+        currentLinearity=NULL;
+}
+/**
+ * \fn buildLinearity
+ * \brief Compute the knots of a range from measured points, see computeKnots
+ * @param nbPoints
+ * @param codes     : measured ADC code, sorted increasing
+ * @param deltas16  : correction to apply at that code, in 1/16 LSB
+ */
+void                         DSOInputGain::buildLinearity(int range,int nbPoints, const int *codes, const int *deltas16)
+{
+    xAssert(range>=0 && range<DSO_NB_GAIN_RANGES);
+    xAssert(nbPoints>0);
+    computeKnots(nbPoints,codes,deltas16,linearity[range]);
+    if(range==(int)currentRange)
+        currentLinearity=linearityOf(range);
+}
 /**
  * 
  * @param mul
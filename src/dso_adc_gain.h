@@ -4,7 +4,12 @@
  
  */
 #pragma once
+#include <stdint.h>
 
+// Optional linearity correction : per range, LINEARITY_KNOTS corrections (in 1/16 LSB)
+// every 512 ADC codes, interpolated in between
+#define LINEARITY_SHIFT 9
+#define LINEARITY_KNOTS ((4096>>LINEARITY_SHIFT)+1)
 
 /**
  */
@@ -35,4 +40,20 @@ public:
     static int                          getOffset(int dc0ac1);
     static float                        getMultiplier();
     static bool                         readCalibrationValue();
+    // Linearity
+    static const int16_t               *getLinearity(); // NULL if the current range is not corrected
+    static int16_t                     *getLinearityTable(int range);
+    static void                         buildLinearity(int range,int nbPoints, const int *codes, const int *deltas16);
+    static void                         computeKnots(int nbPoints, const int *codes, const int *deltas16, int16_t *table);
+    static void                         clearLinearity(int range);
+    /**
+     * \brief ADC code corrected by the table, in 1/16 LSB. Integer only, cheap enough to be done per sample
+     */
+    static inline int                   linearize16(const int16_t *table,int code)
+    {
+        int seg=code>>LINEARITY_SHIFT;
+        int frac=code&((1<<LINEARITY_SHIFT)-1);
+        int d=table[seg]+(((table[seg+1]-table[seg])*frac)>>LINEARITY_SHIFT);
+        return (code<<4)+d;
+    }
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
+#include "dso_adc_gain.h"
 #define DSO_NB_GAIN_RANGES 13
 extern uint16_t calibrationDC[DSO_NB_GAIN_RANGES+1];
 extern uint16_t calibrationAC[DSO_NB_GAIN_RANGES+1];
-extern float    voltageFineTune[DSO_NB_GAIN_RANGES+1];
\ No newline at end of file
+extern float    voltageFineTune[DSO_NB_GAIN_RANGES+1];
+extern int16_t  linearity[DSO_NB_GAIN_RANGES][LINEARITY_KNOTS];
\ No newline at end of file
@@ -0,0 +1,43 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ *
+ * Linearity table math, no dependency on the hardware so it can
+ * be built and exercised on the host
+ ****************************************************/
+#include "dso_adc_gain.h"
+
+/**
+ * \fn computeKnots
+ * \brief Compute the LINEARITY_KNOTS knots from measured points, linear interpolation
+ * between the points, flat beyond the first/last one
+ * @param nbPoints  : >0
+ * @param codes     : measured ADC code, sorted increasing
+ * @param deltas16  : correction to apply at that code, in 1/16 LSB
+ * @param table     : LINEARITY_KNOTS entries
+ */
+void                         DSOInputGain::computeKnots(int nbPoints, const int *codes, const int *deltas16, int16_t *table)
+{
+    int p=0;
+    for(int k=0;k<LINEARITY_KNOTS;k++)
+    {
+        int code=k<<LINEARITY_SHIFT;
+        while(p<nbPoints-1 && codes[p+1]<=code) 
+            p++;
+        int d;
+        if(code<=codes[0])
+            d=deltas16[0];
+        else if(p==nbPoints-1)
+            d=deltas16[nbPoints-1];
+        else
+        {
+            int span=codes[p+1]-codes[p];
+            d=deltas16[p]+((deltas16[p+1]-deltas16[p])*(code-codes[p]))/span;
+        }
+        if(d>32767) d=32767;
+        if(d<-32768) d=-32768;
+        table[k]=(int16_t)d;
+    }
+}
+// EOF
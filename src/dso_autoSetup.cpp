@@ -1,146 +1,137 @@
 /***************************************************
  STM32 duino based firmware for DSO SHELL/150
- * Try to auto set voltage range & frequency
- * Could be better, but that will do for now
+ * Auto set voltage range, time base & trigger
+ *
+ * Instead of stepping through the ranges/time bases one capture at a time
+ * we take a few free running captures and estimate the amplitude and the period
+ * directly from the samples, then jump to the right settings
  *  * GPL v2
  * (c) mean 2019 fixounet@free.fr
  ****************************************************/
 #include "dso_includes.h"
 #include "stopWatch.h"
+#include "dso_autoSetup.h"
 extern float test_samples[256];
+extern void dsoUsb_processBusy();
 
-static bool autoSetupVoltage(bool setTrigger);
-static bool autoSetupFrequency();
+#define AUTOSETUP_PROBE_TIMEBASE    DSOCapture::DSO_TIME_BASE_1MS   // 10 ms window, ~ 200 Hz..6 kHz
+#define AUTOSETUP_SLOW_TIMEBASE     DSOCapture::DSO_TIME_BASE_20MS  // 200 ms window, when the probe sees less than 2 periods
+#define AUTOSETUP_FAST_TIMEBASE     DSOCapture::DSO_TIME_BASE_10US  // when the probe sees less than AUTOSETUP_MIN_PERIOD samples per period
+#define AUTOSETUP_CAPTURE_TIMEOUT   500     // ms, per capture
+#define AUTOSETUP_MIN_PERIOD        4       // samples, below that the period is not reliable
+#define AUTOSETUP_PERIODS           2.5     // periods we want on screen
 
 /**
- * 
+ * \fn probe
+ * \brief Take one free running capture and estimate amplitude & period, see DSOAutoSetup::estimate
+ * @return false if no capture came in time
  */
-void        autoSetup()
+static bool probe(AutoSetupProbe &p)
 {
-    DSOCapture::stopCapture();
-    DSODisplay::drawAutoSetup();
-    // switch to free running mode
-    
-    DSOCapture::setTriggerMode(DSOCapture::Trigger_Run);
-       
-    DSOCapture::DSO_TIME_BASE timeBase=DSOCapture::DSO_TIME_BASE_1MS;
-    DSOCapture::setTimeBase(timeBase);
-    // voltage range
-    
-    if(!autoSetupVoltage(false))         
-        goto end; // failed 
-    DSODisplay::drawAutoSetupStep(1);    
-    if(!autoSetupFrequency()) 
-        goto end;
-    DSODisplay::drawAutoSetupStep(2);    
-    // redo voltage in case it was wrong the 1st time due to too high/too low fq
-    if(!autoSetupVoltage(true)) 
-        goto end; // failed
-    DSODisplay::drawAutoSetupStep(3);    
-end:    
-    DSOCapture::stopCapture();
-    return;
-   
+    CaptureStats stats;
+    StopWatch clock;
+    clock.ok();
+    int n=0;
+    while(!n)
+    {
+        if(clock.elapsed(AUTOSETUP_CAPTURE_TIMEOUT))
+            return false;
+        dsoUsb_processBusy();
+        n=DSOCapture::capture(240,test_samples,stats);
+    }
+    DSOAutoSetup::estimate(test_samples,n,stats.sampleInterval,DSOCapture::getMaxVoltageValue(),p);
+    return true;
 }
 
 /**
- * 
- * @return 
+ * \fn bestVoltageRange
+ * \brief Smallest range (most zoom) that does not saturate with that peak value
  */
-bool autoSetupVoltage(bool setTrigger)
+static DSOCapture::DSO_VOLTAGE_RANGE bestVoltageRange(float xmin,float xmax)
 {
-    int voltage=DSOCapture::DSO_VOLTAGE_5V;
-    DSOCapture::setVoltageRange((DSOCapture::DSO_VOLTAGE_RANGE)voltage);
-    
-    CaptureStats stats;
-    StopWatch clock;
-    clock.ok();
-    int tries=NB_CAPTURE_VOLTAGE+2;
-    while(!clock.elapsed(2000))
-    {
-        int n=DSOCapture::capture(240,test_samples,stats);
-        if(!n)
-            continue;
-        
-        float  xmin= stats.xmin;
-        float  xmax= stats.xmax;
-        
-        xmin=fabs(xmin);
-        xmax=fabs(xmax);
-        if(xmin>xmax) 
-            xmax=xmin;
-        clock.ok();
-        
-        if(tries--<0) return true; // did not converge ?
-        // Are we over the max ?
-        if(xmax>DSOCapture::getMaxVoltageValue() && voltage<DSOCapture::DSO_VOLTAGE_MAX) // saturation            
-        {
-            voltage=voltage+1; // yes, use higher scale
-            DSOCapture::setVoltageRange((DSOCapture::DSO_VOLTAGE_RANGE)voltage);
-            continue;
-        }
-        // is it too small ?, if so take a lower (more zoom) range
-        if(xmax<DSOCapture::getMinVoltageValue() && voltage>1) // too small, voltage =0 means ground, we dont want it
-        {
-            voltage=voltage-1;
-            DSOCapture::setVoltageRange((DSOCapture::DSO_VOLTAGE_RANGE)voltage);
-            continue;
-        }    
-        // Set the trigger
-        float med=(stats.xmin+stats.xmax)/2;
-        if(setTrigger)
-        {
-            DSOCapture::setTriggerValue(med);
-          //  DSOCapture::setTriggerMode(DSOCapture::Trigger_Rising);
-        }
-        
-        return true;
-    } 
-    return false;
+    float peak=fmax(fabs(xmin),fabs(xmax));
+    for(int v=DSOCapture::DSO_VOLTAGE_5MV;v<DSOCapture::DSO_VOLTAGE_MAX;v++)
+        if(peak<DSOCapture::getMaxVoltageValue((DSOCapture::DSO_VOLTAGE_RANGE)v))
+            return (DSOCapture::DSO_VOLTAGE_RANGE)v;
+    return DSOCapture::DSO_VOLTAGE_MAX;
 }
 
+/**
+ * \fn bestTimeBase
+ * \brief Fastest time base showing at least AUTOSETUP_PERIODS periods (10 divisions)
+ */
+static DSOCapture::DSO_TIME_BASE bestTimeBase(float period)
+{
+    for(int t=DSOCapture::DSO_TIME_MIN;t<DSOCapture::DSO_TIME_BASE_MAX;t++)
+    {
+        float window=10./(float)DSOCapture::timeBaseToFrequency((DSOCapture::DSO_TIME_BASE)t);
+        if(window>=period*AUTOSETUP_PERIODS)
+            return (DSOCapture::DSO_TIME_BASE)t;
+    }
+    return DSOCapture::DSO_TIME_BASE_MAX;
+}
 
 /**
- * 
- * @return 
+ * \fn autoSetup
+ * \brief 1 to 3 captures :
+ *   - widest range, probe time base : amplitude => voltage range
+ *   - chosen range : refined amplitude and period
+ *   - only if the period is out of the probe window : slow or fast time base
  */
-bool autoSetupFrequency()
+void        autoSetup()
 {
-    int timeBase=(int)DSOCapture::DSO_TIME_MIN;
-    DSOCapture::setTimeBase((DSOCapture::DSO_TIME_BASE)timeBase);
-    
-    CaptureStats stats;
-    StopWatch clock;
-    clock.ok();
-    int tries=20;
-    while(1)
+    AutoSetupProbe p;
+    DSOCapture::DSO_VOLTAGE_RANGE range;
+
+    DSOCapture::stopCapture();
+    DSODisplay::drawAutoSetup();
+    // switch to free running mode
+    DSOCapture::setTriggerMode(DSOCapture::Trigger_Run);
+    DSOCapture::setTimeBase(AUTOSETUP_PROBE_TIMEBASE);
+    DSOCapture::setVoltageRange(DSOCapture::DSO_VOLTAGE_5V);
+
+    // 1: amplitude
+    if(!probe(p))
+        goto end;
+    range=bestVoltageRange(p.xmin,p.xmax);
+    DSODisplay::drawAutoSetupStep(1);
+
+    // 2: redo with the right range for a finer amplitude & period
+    if(range!=DSOCapture::DSO_VOLTAGE_5V)
+    {
+        DSOCapture::setVoltageRange(range);
+        if(!probe(p))
+            goto end;
+        range=bestVoltageRange(p.xmin,p.xmax);
+        DSOCapture::setVoltageRange(range);
+    }
+    DSODisplay::drawAutoSetupStep(2);
+
+    // 3: period out of the probe window ?
+    if(!p.flat && p.crossings<2)
     {
-        if(clock.elapsed(2000) || timeBase>DSOCapture::DSO_TIME_BASE_MAX)
-        {
-            break;
-        }
-    
-        int n=DSOCapture::capture(240,test_samples,stats);
-        if(!n)
-            continue;
-        if(tries--<0) return true; // did not converge ?
-        if(stats.frequency>30)
-        {
-            // Try to get fq = 4 square
-            int fq=DSOCapture::timeBaseToFrequency((DSOCapture::DSO_TIME_BASE)timeBase);
-            if(0 || stats.frequency<= fq*4)
-            {
-                //
-                // Readjust trigger
-                float trigger=(stats.xmax+stats.xmin)/2.;
-                DSOCapture::setTriggerValue(trigger);
-                return true;
-            }
-        }
-        timeBase++;
-        if(timeBase>DSOCapture::DSO_TIME_BASE_MAX) break;
-        DSOCapture::setTimeBase((DSOCapture::DSO_TIME_BASE)timeBase);
-    } 
-    DSOCapture::setTimeBase(DSOCapture::DSO_TIME_BASE_1MS);
-    return false;
+        DSOCapture::setTimeBase(AUTOSETUP_SLOW_TIMEBASE);
+        if(!probe(p))
+            goto end;
+    }else if(p.period>0 && p.period<AUTOSETUP_MIN_PERIOD*DSOCapture::getSampleInterval())
+    {
+        DSOCapture::setTimeBase(AUTOSETUP_FAST_TIMEBASE);
+        if(!probe(p))
+            goto end;
+    }
+    DSOCapture::setTriggerValue((p.xmin+p.xmax)/2.);
+    if(p.period>0)
+    {
+        // trigger mode first : setTimeBase picks the capture table (running or triggered) from it
+        DSOCapture::setTriggerMode(DSOCapture::Trigger_Rising);
+        DSOCapture::setTimeBase(bestTimeBase(p.period));
+    }else
+    {
+        DSOCapture::setTimeBase(AUTOSETUP_PROBE_TIMEBASE); // DC or too slow, stay free running
+    }
+    DSODisplay::drawAutoSetupStep(3);
+end:
+    DSOCapture::stopCapture();
+    return;
 }
+// EOF
@@ -0,0 +1,28 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+/**
+ * \brief Result of one auto setup probe capture
+ */
+typedef struct
+{
+    float xmin;
+    float xmax;
+    float period;   // s, 0 if unknown
+    int   crossings;
+    bool  flat;     // no significant swing, DC
+}AutoSetupProbe;
+
+/**
+ * \class DSOAutoSetup
+ * \brief Amplitude & period estimate of a capture, no dependency on the hardware
+ */
+class DSOAutoSetup
+{
+public:
+    static void estimate(const float *samples, int n, float sampleInterval, float fullScale, AutoSetupProbe &p);
+};
+// EOF
@@ -0,0 +1,64 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ *
+ * Auto setup estimator, no dependency on the hardware so it can
+ * be built and exercised on the host
+ ****************************************************/
+#include "dso_autoSetup.h"
+
+#define AUTOSETUP_HYSTERESIS        0.1     // fraction of peak to peak used as crossing hysteresis
+#define AUTOSETUP_MIN_SWING         0.05    // fraction of the range full scale, below that it is considered DC
+
+/**
+ * \fn estimate
+ * \brief Amplitude & period of a free running capture
+ * The period is measured on the rising crossings of the mid level, with some hysteresis
+ * so that noise on a slow edge does not count as several crossings
+ * @param samples        : in volt
+ * @param sampleInterval : s
+ * @param fullScale      : max value of the current range, a smaller swing is DC
+ */
+void DSOAutoSetup::estimate(const float *samples, int n, float sampleInterval, float fullScale, AutoSetupProbe &p)
+{
+    p.xmin=samples[0];
+    p.xmax=samples[0];
+    for(int i=1;i<n;i++)
+    {
+        if(samples[i]<p.xmin) p.xmin=samples[i];
+        if(samples[i]>p.xmax) p.xmax=samples[i];
+    }
+    p.period=0;
+    p.crossings=0;
+    p.flat=false;
+
+    float mid=(p.xmin+p.xmax)/2.;
+    float hysteresis=(p.xmax-p.xmin)*AUTOSETUP_HYSTERESIS;
+    if((p.xmax-p.xmin)<fullScale*AUTOSETUP_MIN_SWING)
+    {
+        p.flat=true;
+        return; // no period
+    }
+    bool armed=false;
+    int  first=-1,last=-1;
+    for(int i=0;i<n;i++)
+    {
+        float v=samples[i];
+        if(v<mid-hysteresis)
+        {
+            armed=true;
+            continue;
+        }
+        if(armed && v>mid+hysteresis)
+        {
+            armed=false;
+            if(first<0) first=i;
+            last=i;
+            p.crossings++;
+        }
+    }
+    if(p.crossings>=2)
+        p.period=((float)(last-first)*sampleInterval)/(float)(p.crossings-1);
+}
+// EOF
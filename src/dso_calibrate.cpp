@@ -10,7 +10,9 @@
 #include "dso_adc_gain.h"
 #include "dso_adc_gain_priv.h"
 #include "dso_gfx.h"
+#include "dso_calibrate_settle.h"
 extern DSOADC                     *adc;
+extern void dsoUsb_processBusy();
 
 #define SHORT_PRESS(x) (controlButtons->getButtonEvents(DSOControl::x)&EVENT_SHORT_PRESS)
 
@@ -22,6 +24,7 @@ static void waitOk()
     while(!SHORT_PRESS(DSO_BUTTON_OK)) 
     {
         xDelay(10);
+        dsoUsb_processBusy();
     }
 }
 
@@ -53,7 +56,8 @@ static void  waitForCoupling(DSOControl::DSOCoupling target)
     DSO_GFX::center(st,100);
     while(1)
     {
-            controlButtons->updateCouplingState();
+            xDelay(10);
+            dsoUsb_processBusy();
             DSOControl::DSOCoupling   newcpl=controlButtons->getCouplingState(); 
             if(newcpl==target) 
                 tft->setTextColor(GREEN,BLACK);
@@ -105,6 +109,62 @@ static int averageADCRead()
     return sum;
 }
 
+
+#define CALIBRATION_FQ          12000 // Hz, 239.5 cycles sampling time is still comfortable at that rate
+#define CALIBRATION_BLOCK       240   // samples per block, 20 ms i.e. a full 50 Hz period
+/**
+ * \brief Setup the ADC once for all the ranges
+ */
+static void prepareZeroRead()
+{
+    adc->setupTimerSampling(); 
+    adc->prepareTimerSampling(CALIBRATION_FQ,1,ADC_SMPR_239_5, DSOADC::ADC_PRESCALER_8);
+}
+/**
+ * \brief Average of one block, oversampled i.e. in 1/16 LSB
+ */
+static int blockRead16()
+{
+    adc->startTimerSampling(CALIBRATION_BLOCK);
+    FullSampleSet fset;
+    while(!adc->getSamples(fset))
+    {
+        
+    };
+    int nb=fset.set1.samples;
+    xAssert(nb);
+    int sum=0;
+    for(int i=0;i<nb;i++)
+    {
+        sum+=fset.set1.data[i];
+    }
+    return (sum*16+nb/2)/nb;
+}
+/**
+ * \fn settledADCRead
+ * \brief Read blocks until the last CALIBRATION_WINDOW averages agree, this absorbs 
+ * the settling of the front end after a gain change : no fixed delay, and usually
+ * 60 ms per range instead of 200+10 ms, see DSOSettle
+ * @return zero level in LSB, rounded
+ */
+static int settledADCRead()
+{
+    DSOSettle settle;
+    while(!settle.add(blockRead16()))
+    {
+    }
+    return settle.value();
+}
+/**
+ * 
+ * @param range
+ */
+static void printProgress(const char *txt,int range)
+{
+    char st[32];
+    sprintf(st,"%s %d/%d",txt,range,DSO_NB_GAIN_RANGES);
+    DSO_GFX::center(st,155);
+}
 /**
  * 
  * @param array
@@ -115,12 +175,14 @@ static int averageADCRead()
 void doCalibrate(uint16_t *array,int color, const char *txt,DSOControl::DSOCoupling target)
 {
     header(color,txt,target);     
+    prepareZeroRead();
     for(int range=0;range<DSO_NB_GAIN_RANGES;range++)
     {
+        printProgress(txt,range);
         DSOInputGain::setGainRange((DSOInputGain::InputGainRange) range);
-        xDelay(10);
-        array[range]=averageADCRead();
+        array[range]=settledADCRead();
     }
+    printProgress(txt,DSO_NB_GAIN_RANGES);
 }
 
 /**
@@ -137,8 +199,8 @@ bool DSOCalibrate::zeroCalibrate()
     adc->setTimeScale(ADC_SMPR_1_5,DSOADC::ADC_PRESCALER_2); // 10 us *1024 => 10 ms scan
     printCalibrationTemplate("Connect the 2 crocs","together");
     waitOk();    
-    doCalibrate(calibrationDC,YELLOW,"",DSOControl::DSO_COUPLING_DC);       
-    doCalibrate(calibrationAC,GREEN, "",DSOControl::DSO_COUPLING_AC);    
+    doCalibrate(calibrationDC,YELLOW,"DC",DSOControl::DSO_COUPLING_DC);       
+    doCalibrate(calibrationAC,GREEN, "AC",DSOControl::DSO_COUPLING_AC);    
     DSOEeprom::write();         
     tft->fillScreen(0);    
     DSO_GFX::printxy(20,100,"Restart the unit.");
@@ -222,6 +284,9 @@ bool DSOCalibrate::voltageCalibrate()
         else
             voltageFineTune[dex]=0;
     }    
+    // the linearity tables were measured with the old multipliers
+    for(int i=0;i<DSO_NB_GAIN_RANGES;i++)
+        DSOInputGain::clearLinearity(i);
     // If we have both 100mv and 2v
     DSOEeprom::write();     
     DSOEeprom::readFineVoltage    ();
@@ -289,6 +354,7 @@ float performVoltageCalibration(const char *title, float expected,float defalt,f
     
     while(1)
     {   // Raw read
+        dsoUsb_processBusy();
         int sum=averageADCRead();        
         sum-=offset;               
         float f=expected;
@@ -309,3 +375,107 @@ float performVoltageCalibration(const char *title, float expected,float defalt,f
              return previous;
     }    
 }
+
+#define LINEARITY_POINTS 4 // 1/4, 2/4, 3/4 and 4/4 of the calibration voltage
+enum LinearityAction
+{
+    LINEARITY_SET,
+    LINEARITY_SKIP,
+    LINEARITY_CLEAR
+};
+/**
+ * \brief Wait for the user to apply the expected voltage and validate
+ * @param measured : averaged ADC code
+ */
+static LinearityAction measureLinearityPoint(const char *title, float expected, int ideal, int &measured)
+{
+    char st[32];
+    fineHeader(title);
+    LOWER_BAR_PRINT(0,"CLEAR"); // volt
+    LOWER_BAR_PRINT(3,"SKIP");  // trig
+    sprintf(st,"@ %d mV @",(int)(expected*1000.));
+    DSO_GFX::center(st,70);
+    DSO_GFX::printxy(10,110, "@Expected@");
+    DSO_GFX::printxy(200,110,"@  ADC  @");
+    printInt(10,130,ideal);
+    
+    // clear button state
+    SHORT_PRESS(DSO_BUTTON_OK);
+    SHORT_PRESS(DSO_BUTTON_VOLTAGE);
+    SHORT_PRESS(DSO_BUTTON_TRIGGER);
+    xDelay(100);
+    while(1)
+    {
+        dsoUsb_processBusy();
+        measured=averageADCRead();
+        printInt(200,130,measured);
+        if( SHORT_PRESS(DSO_BUTTON_OK))
+             return LINEARITY_SET;
+        if( SHORT_PRESS(DSO_BUTTON_VOLTAGE))
+             return LINEARITY_CLEAR;
+        if( SHORT_PRESS(DSO_BUTTON_TRIGGER))
+             return LINEARITY_SKIP;
+    }
+}
+/**
+ * \fn linearityCalibrate
+ * \brief Optional multi-point calibration, done after the fine one.
+ * For each range the user applies 1/4 .. 4/4 of the calibration voltage, the difference 
+ * between the expected and the measured code is the correction at that code.
+ * The zero point comes from the basic calibration, i.e. no correction there.
+ * SKIP keeps the current table of the range, CLEAR removes it.
+ * @return 
+ */
+bool DSOCalibrate::linearityCalibrate()
+{
+    tft->setFontSize(Adafruit_TFTLCD_8bit_STM32::MediumFont);  
+    DSO_GFX::newPage("LINEARITY CALIBRATION");
+    DSO_GFX::bottomLine("press @OK@ when ready");
+    waitForCoupling(DSOControl::DSO_COUPLING_DC);    
+    
+    adc_set_sample_rate(ADC2, ADC_SMPR_239_5);
+    int nb=sizeof(myCalibrationVoltage)/sizeof(MyCalibrationVoltage);
+    for(int i=0;i<nb;i++)
+    {                
+        DSOInputGain::InputGainRange  range=myCalibrationVoltage[i].range;
+        DSOInputGain::setGainRange(range);
+        int   offset=DSOInputGain::getOffset(0);
+        float multiplier=DSOInputGain::getMultiplier();
+        int codes[LINEARITY_POINTS+1];
+        int deltas[LINEARITY_POINTS+1];
+        codes[0]=offset;
+        deltas[0]=0;
+        int n=1;
+        LinearityAction action=LINEARITY_SET;
+        for(int p=1;p<=LINEARITY_POINTS && action==LINEARITY_SET;p++)
+        {
+            float expected=(myCalibrationVoltage[i].expected*(float)p)/(float)LINEARITY_POINTS;
+            float ideal=(float)offset+expected/multiplier;
+            int measured;
+            action=measureLinearityPoint(myCalibrationVoltage[i].title,expected,(int)(ideal+0.5),measured);
+            if(action!=LINEARITY_SET)
+                break;
+            // keep them sorted by code
+            int j=n;
+            while(j>0 && codes[j-1]>measured)
+            {
+                codes[j]=codes[j-1];
+                deltas[j]=deltas[j-1];
+                j--;
+            }
+            codes[j]=measured;
+            deltas[j]=(int)((ideal-(float)measured)*16.);
+            n++;
+        }
+        switch(action)
+        {
+            case LINEARITY_SET:   DSOInputGain::buildLinearity((int)range,n,codes,deltas);break;
+            case LINEARITY_CLEAR: DSOInputGain::clearLinearity((int)range);break;
+            default: break;
+        }
+    }    
+    DSOEeprom::write();     
+    tft->fillScreen(0);
+    return true;         
+}
+// EOF
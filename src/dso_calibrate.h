@@ -10,4 +10,5 @@ public:
   static bool zeroCalibrate();
   static bool decalibrate();
   static bool voltageCalibrate();
+  static bool linearityCalibrate();
 };
\ No newline at end of file
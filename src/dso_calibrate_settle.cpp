@@ -0,0 +1,43 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ *
+ * Calibration settle decision, no dependency on the hardware so it can
+ * be built and exercised on the host
+ ****************************************************/
+#include "dso_calibrate_settle.h"
+
+/**
+ * \fn add
+ * \brief One more block average
+ * @param block16 : average of the block in 1/16 LSB
+ * @return true when the last CALIBRATION_WINDOW blocks agree within CALIBRATION_TOLERANCE
+ * or after CALIBRATION_MAX_BLOCKS blocks
+ */
+bool DSOSettle::add(int block16)
+{
+    history[n%CALIBRATION_WINDOW]=block16;
+    n++;
+    if(n<CALIBRATION_WINDOW)
+        return false;
+    int mn=history[0],mx=history[0];
+    for(int i=1;i<CALIBRATION_WINDOW;i++)
+    {
+        if(history[i]<mn) mn=history[i];
+        if(history[i]>mx) mx=history[i];
+    }
+    return mx-mn<=CALIBRATION_TOLERANCE || n>=CALIBRATION_MAX_BLOCKS;
+}
+/**
+ * \fn value
+ * \brief Average of the last CALIBRATION_WINDOW blocks, in LSB, rounded
+ */
+int DSOSettle::value() const
+{
+    int sum=0;
+    for(int i=0;i<CALIBRATION_WINDOW;i++)
+        sum+=history[i];
+    return (sum+8*CALIBRATION_WINDOW)/(16*CALIBRATION_WINDOW);
+}
+// EOF
@@ -0,0 +1,28 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+
+#define CALIBRATION_WINDOW      3     // the last 3 blocks must agree...
+#define CALIBRATION_TOLERANCE   8     // ... within 1/2 LSB (in 1/16 LSB)
+#define CALIBRATION_MAX_BLOCKS  16    // give up waiting after ~ 320 ms and use what we have
+
+/**
+ * \class DSOSettle
+ * \brief Decides when the front end has settled after a gain change, from the
+ * averages of consecutive blocks. No dependency on the hardware
+ */
+class DSOSettle
+{
+public:
+                DSOSettle() {n=0;}
+        bool    add(int block16);
+        int     value() const;
+        int     blocks() const {return n;}
+protected:
+        int     history[CALIBRATION_WINDOW];
+        int     n;
+};
+// EOF
@@ -13,16 +13,23 @@
 #include "DSO_config.h"
 #include "fancyLock.h"
 #include "pinConfiguration.h"
+#include "dso_static.h"
+#include "dso_rotary.h"
 #define TICK                  10 // 10 ms
+#define COUPLING_PERIOD       100 // ms, between 2 samples of the coupling switch
+#define COUPLING_DEBOUNCE     3   // a new coupling must be seen that many times in a row
+#define IDLE_POLL             50 // ms, when no button is active, only to catch presses whose edge was masked by the LCD
 #define LONG_PRESS_THRESHOLD (1000/TICK) // 1s
 #define SHORT_PRESS_THRESHOLD (3) // 20 ms
 #define HOLDOFF_THRESHOLD     (100/TICK)
 #define COUNT_MAX             4
 
 extern uint16_t directADC2Read(int pin);
+extern volatile bool adc2InUse;
 
 int debugUp=0;
 int debugDown=0;
+DSO_STATIC_TASK(control,DSO_CONTROL_TASK_STACK)
 
 int ampMapping[16]=
 {
@@ -56,6 +63,8 @@ int ampMapping[16]=
 #define ButtonToPin(x)    (PB0+x)
 #define pinAsInput(x)     pinMode(ButtonToPin(x),INPUT_PULLUP);
 #define attachRE(x)       attachInterrupt(ButtonToPin(x),_myInterruptRE,(void *)x,FALLING );
+#define attachButton(x)   attachInterrupt(ButtonToPin(x),_myInterruptButton,(void *)x,FALLING );
+#define BUTTON_MASK       (((1<<(DSO_BUTTON_OK+1))-1) & ~((1<<DSO_BUTTON_ROTARY)-1)) // PB3..PB7, active low
 
 #define NB_BUTTONS 8
 
@@ -87,6 +96,10 @@ public:
                         }
                         return true;
                     }
+                    bool idle() // nothing pressed, nothing to debounce
+                    {
+                        return _state==StateIdle && !_pinCounter && !_pinState;
+                    }
                     void goToHoldOff()
                     {
                         _state=StateHoldOff;
@@ -160,6 +173,8 @@ static singleButton _buttons[NB_BUTTONS];
 
 static int state;  // rotary state
 static int counter; // rotary counter
+static int accelCounter; // same with acceleration
+static uint32_t lastDetent; // millis() of the last detent
 
 static TaskHandle_t taskHandle;
 extern void useAdc2(bool use);
@@ -173,6 +188,14 @@ static void _myInterruptRE(void *a)
     ints++;
     instance->interruptRE(!!a);
 }
+/**
+ * \brief A button went down, wake up the control task
+ * @param a
+ */
+static void _myInterruptButton(void *a)
+{
+    instance->interruptButton((int)a);
+}
 /**
  * 
  * @param button
@@ -204,10 +227,21 @@ int DSOControl::getRawCoupling()
  
 /**
  * 
- * @param v
+ * @param raw
  * @return 
  */
 extern void Logger(const char *fmt...);
+static DSOControl::DSOCoupling couplingFromRaw(int raw)
+{
+    if(raw>3200)      
+        return DSOControl::DSO_COUPLING_AC;
+    if(raw<1000)       
+        return DSOControl::DSO_COUPLING_GND;
+    return DSOControl::DSO_COUPLING_DC;
+}
+/**
+ * \brief Blocking read, only used at startup before any capture
+ */
 static DSOControl::DSOCoupling couplingFromAdc2()
 {
     
@@ -218,11 +252,25 @@ static DSOControl::DSOCoupling couplingFromAdc2()
     //Logger("Coupling=%d\n",rawCoupling);
     
     useAdc2(false);
-    if(rawCoupling>3200)      
-        return DSOControl::DSO_COUPLING_AC;
-    if(rawCoupling<1000)       
-        return DSOControl::DSO_COUPLING_GND;
-    return DSOControl::DSO_COUPLING_DC;
+    return couplingFromRaw(rawCoupling);
+}
+/**
+ * \brief Read the coupling pin if ADC2 is not used by a capture
+ * Done in a critical section so that neither the capture task nor the DMA interrupt
+ * can grab ADC2 in the middle of the (single, short) conversion
+ * @return false if ADC2 was busy
+ */
+static bool tryCouplingFromAdc2(int &raw)
+{
+    bool done=false;
+    taskENTER_CRITICAL();
+    if(!adc2InUse)
+    {
+        raw=directADC2Read(COUPLING_PIN);
+        done=true;
+    }
+    taskEXIT_CRITICAL();
+    return done;
 }
 /**
  * 
@@ -232,6 +280,8 @@ DSOControl::DSOControl()
     state = R_START;
     instance=this;
     counter=0;
+    accelCounter=0;
+    lastDetent=0;
     
 #ifdef USE_RXTX_PIN_FOR_ROTARY
     pinMode(ALT_ROTARY_LEFT,OUTPUT); // ok
@@ -269,19 +319,41 @@ static void trampoline(void *a)
 }
 
 /**
- * Read the coupling pin every 300 ms or so
+ * Sample the coupling pin every COUPLING_PERIOD, called by the control task
  * It's value depends on the coupling selector
  * ~ 0 / ~ 2000 / ~ 4000
+ * The sample is skipped if a capture is using ADC2, and a new state is only
+ * accepted once it has been seen COUPLING_DEBOUNCE times in a row, the others
+ * just read the cached couplingState
  */
 static uint32_t lastUpdate=0;
+static int      candidateCoupling=-1;
+static int      candidateCount=0;
 void          DSOControl::updateCouplingState()
 {
     uint32_t now=millis();
-    if(now>lastUpdate+500)
+    if(now-lastUpdate<COUPLING_PERIOD)
+        return;
+    int raw;
+    if(!tryCouplingFromAdc2(raw))
+        return; // try again next time
+    lastUpdate=now;
+    rawCoupling=raw;
+    DSOCoupling cpl=couplingFromRaw(raw);
+    if(cpl==couplingState)
     {
-        couplingState=couplingFromAdc2();
-        
-        lastUpdate=now;
+        candidateCount=0;
+        return;
+    }
+    if(cpl!=candidateCoupling)
+    {
+        candidateCoupling=cpl;
+        candidateCount=0;
+    }
+    if(++candidateCount>=COUPLING_DEBOUNCE)
+    {
+        couplingState=cpl;
+        candidateCount=0;
     }
 }
 
@@ -310,43 +382,49 @@ DSOControl::DSOCoupling  DSOControl::getCouplingState()
 }
 
 /**
- * 
+ * \fn runLoop
+ * \brief Debounce the buttons every TICK while one of them is active
+ * When they are all idle, sleep until a button interrupt (or IDLE_POLL) 
  */
 void DSOControl::runLoop()
 {
     xDelay(5);
-    int base=millis()&0xffff;
+    TickType_t lastWake=xTaskGetTickCount();
+    bool active=true;
     while(1)
     {
-        static int next=(base+TICK) & 0xffff;;
-        static int now=(millis()&0xffff);
-        static int wait;
-        
-        base=next&0xffff;        
-        if(next<now) next+=0x10000;
-        wait=next-now;
-        xAssert(wait<=TICK);
-        if(wait>0 ) // no wrap
+        if(active)
+        {
+            vTaskDelayUntil(&lastWake,TICK);
+        }else
         {
-            xAssert(wait<=TICK);         
-            xDelay(wait);
+            ulTaskNotifyTake(pdTRUE,IDLE_POLL);
+            lastWake=xTaskGetTickCount();
         }
+        updateCouplingState();
         
         PortAMutex.lock(); // make sure we have control over GPIOB
         uint32_t val= GPIOB->regs->IDR;     
         PortAMutex.unlock();
+        if(!active && (val&BUTTON_MASK)==BUTTON_MASK)
+            continue; // still nothing pressed
+        active=false;
         for(int i=DSO_BUTTON_ROTARY;i<=DSO_BUTTON_OK;i++)
         {
             singleButton &button=_buttons[i];
             if(button.holdOff()) 
+            {
+                active=true;
                 continue;
+            }
             
             int k=!(val&(1<<i));
             
             int oldCount=button._pinCounter;
             button.integrate(k);
             button.runMachine(oldCount);
-          
+            if(!button.idle())
+                active=true;
         }        
     }
 }
@@ -357,6 +435,8 @@ void DSOControl::runLoop()
  */
 bool DSOControl::setup()
 {
+    // The task first : the button interrupts notify it as soon as they are attached
+    taskHandle=xTaskCreateStatic( trampoline, "Control", DSO_CONTROL_TASK_STACK, this, DSO_CONTROL_TASK_PRIORITY, controlStack, &controlTcb );
 #ifdef USE_RXTX_PIN_FOR_ROTARY         
      attachInterrupt(ALT_ROTARY_LEFT,_myInterruptRE,(void *)DSO_BUTTON_UP,CHANGE );
      attachInterrupt(ALT_ROTARY_RIGHT,_myInterruptRE,(void *)DSO_BUTTON_DOWN,CHANGE );
@@ -364,14 +444,25 @@ bool DSOControl::setup()
     attachRE(DSO_BUTTON_UP);
     attachRE(DSO_BUTTON_DOWN);
 #endif
-    xTaskCreate( trampoline, "Control", 250, this, DSO_CONTROL_TASK_PRIORITY, &taskHandle );       
+    for(int i=DSO_BUTTON_ROTARY;i<=DSO_BUTTON_OK;i++)
+        attachButton(i);
     return true;
 }
+/**
+ * \brief One detent in the direction dir, the faster the spin the bigger the accelerated step
+ */
+static void detent(int dir)
+{
+    uint32_t now=millis();
+    uint32_t delta=now-lastDetent;
+    lastDetent=now;
+    counter+=dir;
+    accelCounter+=dir*DSORotary::accelStep(delta);
+}
 /**
  * 
  * @param a
  */
-
 void DSOControl::interruptRE(int a)
 {   
 #ifdef USE_RXTX_PIN_FOR_ROTARY    
@@ -383,11 +474,11 @@ void DSOControl::interruptRE(int a)
   {
     case DIR_CW:
             debugUp++;
-            counter++;
+            detent(1);
             break;
     case DIR_CCW: 
             debugDown++;
-            counter--;
+            detent(-1);
             break;
     default: 
             break;
@@ -400,16 +491,29 @@ void DSOControl::interruptRE(int a)
   switch(state&DIR_MASK)
   {
     case DIR_CW:
-            counter--;
+            detent(-1);
             break;
     case DIR_CCW: 
-            counter++;
+            detent(1);
             break;
     default: 
             break;
   }
 #endif  
 }
+/**
+ * \brief Called from the EXTI interrupt, the pin is only read here to skip obvious glitches
+ * the debounce itself is done by the control task
+ * @param button
+ */
+void DSOControl::interruptButton(int button)
+{
+    if(GPIOB->regs->IDR & (1<<button))
+        return; // already back up
+    BaseType_t wake=pdFALSE;
+    vTaskNotifyGiveFromISR(taskHandle,&wake);
+    portYIELD_FROM_ISR(wake);
+}
 /**
  * 
  * @param button
@@ -432,13 +536,18 @@ int  DSOControl::getButtonEvents(DSOButton button)
 }
 
 /**
- * 
+ * \fn getRotaryValue
+ * \brief Detents since the last call, both counters are consumed
+ * @param accelerated : use the velocity scaled count, for continuous values (offset, trigger level...)
  * @return 
  */
-int  DSOControl::getRotaryValue()
+int  DSOControl::getRotaryValue(bool accelerated)
 {
     // Avoid disabling interrupts    
     int evt = __atomic_exchange_n( &(counter), 0, __ATOMIC_SEQ_CST);
+    int acc = __atomic_exchange_n( &(accelCounter), 0, __ATOMIC_SEQ_CST);
+    if(accelerated)
+        return acc;
     return evt;
 }
 
@@ -38,7 +38,7 @@ public:
     bool setup();
     bool getButtonState(DSOButton button);
     int  getButtonEvents(DSOButton button);
-    int  getRotaryValue();
+    int  getRotaryValue(bool accelerated=false);
     void interruptRE(int button);
     void interruptButton(int button);
     void runLoop();
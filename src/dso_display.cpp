@@ -12,6 +12,8 @@
 #include "dso_display.h"
 #include "pattern.h"
 #include "stopWatch.h"
+#include "dso_readout.h"
+#include "dso_format.h"
 
 
 #define AUTOCAL_BOX_WIDTH   200
@@ -28,7 +30,21 @@ static DSODisplay::MODE_TYPE mode=DSODisplay::VOLTAGE_MODE;
  */
 uint8_t prevPos[256];
 uint8_t prevSize[256];
-static char textBuffer[24];
+/**
+ * Persistence : one bit per pixel of the waveform area, set when a trace went through it
+ * (240x192 bits, 5.76 KB). Stored by column so a trace segment is a few word operations.
+ * Only the pixels that change are redrawn : a hit is painted with the persistence color
+ * when the trace leaves it, a pixel is given its background back when its hit decays.
+ * In decay mode, each frame one word of each column loses a random half of its hits,
+ * so a hit lasts ~ 2*PERSISTENCE_WORDS frames and old traces dissolve like phosphor
+ */
+#define PERSISTENCE_COLOR       MK_COLOR(0x0C,0x18,0)
+#define PERSISTENCE_WORDS       (DSO_WAVEFORM_HEIGHT/32)
+static DSODisplay::PERSISTENCE_MODE persistence=DSODisplay::PERSISTENCE_OFF;
+static uint32_t persistMap[DSO_WAVEFORM_WIDTH][PERSISTENCE_WORDS];
+static int      persistFrame=0;
+static uint32_t persistRandom=0x12345678;
+static char textBuffer[DSO_FORMAT_BUFFER_SIZE];
 
 //-
 #define SCALE_STEP 24
@@ -49,16 +65,147 @@ static const uint16_t *getBackGround(int line)
  */
 static const char *fq2Text(int fq)
 {
-    static char buff[16];
-    float  f=fq;
-    const char *suff="";
-#define STEP(x,t)  if(f>x)     {suff=t;f/=(float)x;}else
-
-    STEP(1000000,"M")
-    STEP(1000,"K")
-    {}
-    sprintf(buff,"%2.1f%s",f,suff);
-    return buff;
+    static char buff[DSO_FORMAT_BUFFER_SIZE];
+    return DSOFormat::frequency(fq,buff);
+}
+/**
+ * \brief restore n lines of background in column, starting at line from
+ */
+static void pushBackground(int column,int from, int n)
+{
+    const uint16_t *bg=getBackGround(column);
+    tft->setAddrWindow(column,from+DSO_WAVEFORM_OFFSET,column,DSO_WAVEFORM_HEIGHT+DSO_WAVEFORM_OFFSET);
+    tft->pushColors(((uint16_t *)bg)+from,   n,true);
+}
+static inline bool isHit(int column, int line)
+{
+    if(line<0 || line>=DSO_WAVEFORM_HEIGHT) return false;
+    return (persistMap[column][line>>5]>>(line&31))&1;
+}
+/**
+ * \brief Repaint lines [from,to) of a column from the hit map : persistence color
+ * where there is a hit, the background elsewhere. Runs are drawn in one go.
+ */
+static void drawFromMap(int column, int from, int to)
+{
+    while(from<to)
+    {
+        bool hit=isHit(column,from);
+        int end=from+1;
+        while(end<to && isHit(column,end)==hit)
+            end++;
+        if(hit)
+            tft->drawFastVLine(column,from+DSO_WAVEFORM_OFFSET,end-from,PERSISTENCE_COLOR);
+        else
+            pushBackground(column,from,end-from);
+        from=end;
+    }
+}
+/**
+ * \brief Erase a trace segment, the hits under it get the persistence color,
+ * the rest gets the background back
+ * @param column
+ * @param start
+ * @param size
+ */
+static void restoreSegment(int column,int start, int size)
+{
+    if(persistence==DSODisplay::PERSISTENCE_OFF)
+    {
+        pushBackground(column,start,size);
+        return;
+    }
+    drawFromMap(column,start,start+size);
+}
+/**
+ * \brief Set the hits of the new segment, they are covered by the trace and
+ * will get the persistence color when it moves
+ * @param column
+ * @param start
+ * @param size
+ */
+static void accumulate(int column, int start, int size)
+{
+    int end=start+size;
+    if(end>DSO_WAVEFORM_HEIGHT) end=DSO_WAVEFORM_HEIGHT;
+    uint32_t *words=persistMap[column];
+    for(int line=start;line<end;)
+    {
+        int bit=line&31;
+        int n=32-bit;
+        if(n>end-line) n=end-line;
+        uint32_t mask=(n==32) ? 0xffffffff : (((1U<<n)-1)<<bit);
+        words[line>>5]|=mask;
+        line+=n;
+    }
+}
+/**
+ * \brief Decay one word of the column, half of its hits at random go
+ * The pixels are erased right away, except the ones under the current trace
+ * @param column
+ * @param start : current trace segment
+ * @param size
+ */
+static void decay(int column, int start, int size)
+{
+    int w=persistFrame%PERSISTENCE_WORDS;
+    uint32_t hits=persistMap[column][w];
+    if(!hits) return;
+    persistRandom^=persistRandom<<13; // xorshift32
+    persistRandom^=persistRandom>>17;
+    persistRandom^=persistRandom<<5;
+    uint32_t lost=hits&persistRandom;
+    persistMap[column][w]=hits&~lost;
+    while(lost)
+    {
+        int bit=__builtin_ctz(lost);
+        lost&=lost-1;
+        int line=w*32+bit;
+        if(line<start || line>=start+size)
+            pushBackground(column,line,1);
+    }
+}
+/**
+ * 
+ * @param erase : if true the hits are removed from the screen, else we assume the screen has been wiped
+ */
+void DSODisplay::clearPersistence(bool erase)
+{
+    for(int i=0;i<DSO_WAVEFORM_WIDTH;i++)
+    {
+        if(erase && persistence!=PERSISTENCE_OFF)
+        {
+            int first=-1,last=-1;
+            for(int line=0;line<DSO_WAVEFORM_HEIGHT;line++)
+                if(isHit(i,line))
+                {
+                    if(first<0) first=line;
+                    last=line;
+                }
+            if(first>=0)
+                pushBackground(i,first,last+1-first);
+        }
+        for(int w=0;w<PERSISTENCE_WORDS;w++)
+            persistMap[i][w]=0;
+    }
+    persistFrame=0;
+}
+/**
+ * 
+ * @param p
+ */
+void DSODisplay::setPersistence(PERSISTENCE_MODE p)
+{
+    clearPersistence(true);
+    persistence=p;
+}
+/**
+ * 
+ * @return 
+ */
+DSODisplay::PERSISTENCE_MODE DSODisplay::getPersistence()
+{
+    return persistence;
 }
 /**
  * 
@@ -70,6 +217,7 @@ void DSODisplay::init()
         prevPos[i]=120;
         prevSize[i]=1;
     }
+    clearPersistence(false);
     triggerWatch.elapsed(0);
 }
 
@@ -88,6 +236,10 @@ void  DSODisplay::drawWaveForm(int count,const uint8_t *data)
     int start,sz;
     
     if(count<3) return;
+    bool persist=(persistence!=PERSISTENCE_OFF);
+    bool decaying=(persistence==PERSISTENCE_DECAY);
+    if(decaying)
+        persistFrame++;
     for(int j=1;j<count-1;j++)
     {
         int next=data[j]; // in pixel
@@ -104,10 +256,16 @@ void  DSODisplay::drawWaveForm(int count,const uint8_t *data)
             start=1;
         }
 
-        const uint16_t *bg=getBackGround(j);
         // cleanup prev draw
-        tft->setAddrWindow(j,prevPos[j]+DSO_WAVEFORM_OFFSET,j,DSO_WAVEFORM_HEIGHT+DSO_WAVEFORM_OFFSET);
-        tft->pushColors(((uint16_t *)bg)+prevPos[j],   prevSize[j],true);
+        if(persist)
+        {
+            restoreSegment(j,prevPos[j],prevSize[j]);
+            accumulate(j,start,sz);
+            if(decaying)
+                decay(j,start,sz);
+        }
+        else
+            pushBackground(j,prevPos[j],prevSize[j]);
         tft->drawFastVLine(j,start+DSO_WAVEFORM_OFFSET,sz,YELLOW);
         prevSize[j]=sz;
         prevPos[j]=start;
@@ -155,6 +313,21 @@ void  DSODisplay::drawVerticalTrigger(bool drawOrErase,int column)
         const uint16_t *bg=getBackGround(column);
         tft->setAddrWindow(column,1+DSO_WAVEFORM_OFFSET,column,DSO_WAVEFORM_HEIGHT+DSO_WAVEFORM_OFFSET-1);
         tft->pushColors(((uint16_t *)bg),   DSO_WAVEFORM_HEIGHT,true);
+        if(persistence!=PERSISTENCE_OFF && column<DSO_WAVEFORM_WIDTH)
+        {
+            for(int line=0;line<DSO_WAVEFORM_HEIGHT;)
+            {
+                if(!isHit(column,line)) 
+                {
+                    line++;
+                    continue;
+                }
+                int end=line+1;
+                while(isHit(column,end)) end++;
+                tft->drawFastVLine(column,line+DSO_WAVEFORM_OFFSET,end-line,PERSISTENCE_COLOR);
+                line=end;
+            }
+        }
     }
 }
 /**
@@ -176,6 +349,13 @@ void  DSODisplay::drawVoltageTrigger(bool drawOrErase, int line)
         tft->setAddrWindow( 0,                  1+line,
                             DSO_WAVEFORM_WIDTH, 1+line);
         tft->pushColors(((uint16_t *)bg),   DSO_WAVEFORM_WIDTH,true);
+        if(persistence!=PERSISTENCE_OFF)
+        {
+            int y=1+line-DSO_WAVEFORM_OFFSET; // in waveform coordinates
+            for(int i=0;i<DSO_WAVEFORM_WIDTH;i++)
+                if(isHit(i,y))
+                    tft->drawPixel(i,1+line,PERSISTENCE_COLOR);
+        }
     }
 #if 0    
      tft->setCursor(240,16);tft->print(debugUp);
@@ -191,51 +371,47 @@ void  DSODisplay::drawVoltageTrigger(bool drawOrErase, int line)
 #define DSO_INFO_MAX_WIDTH  (320-DSO_INFO_START_COLUMN-8)
 
 
+#define READOUT_X (DSO_INFO_START_COLUMN+4)
+#define READOUT_Y(y) (DSO_HEIGHT_OFFSET+(y)*DSO_CHAR_HEIGHT)
+
+static DSOReadout avgReadout(       READOUT_X,READOUT_Y(1), DSO_INFO_MAX_WIDTH);
+static DSOReadout minReadout(       READOUT_X,READOUT_Y(3), DSO_INFO_MAX_WIDTH);
+static DSOReadout maxReadout(       READOUT_X,READOUT_Y(5), DSO_INFO_MAX_WIDTH);
+static DSOReadout freqReadout(      READOUT_X,READOUT_Y(7), DSO_INFO_MAX_WIDTH);
+static DSOReadout triggerReadout(   READOUT_X,READOUT_Y(9), DSO_INFO_MAX_WIDTH);
+static DSOReadout offsetReadout(    READOUT_X,READOUT_Y(11),DSO_INFO_MAX_WIDTH);
+
 /**
  * 
- * @param stats
+ * @param x
+ * @return 
  */
-
-static void prettyPrint(float x,int mx)
+static const char *prettyPrint(float x)
 {
-    float a=fabs(x);
-  
-    if(a<0.8)
-    {
-        if(a<0.001)
-            sprintf(textBuffer,"%03du",(int)(1000000.*x));
-        else
-            sprintf(textBuffer,"%03dm",(int)(1000.*x));
-    }
-    else
-        sprintf(textBuffer,"%02.2f",x);
-  tft->myDrawString(textBuffer,mx);   
+    return DSOFormat::voltage(x,textBuffer);
 }
-
+/**
+ * 
+ * @param stats
+ */
 void DSODisplay::drawStats(CaptureStats &stats)
 {
     
 #define AND_ONE_A(x,y) { tft->setCursor(DSO_INFO_START_COLUMN+2, DSO_HEIGHT_OFFSET+y*DSO_CHAR_HEIGHT); tft->myDrawString(x,DSO_INFO_MAX_WIDTH);}        
-#define AND_ONE_T(x,y) { tft->setCursor(DSO_INFO_START_COLUMN+4, DSO_HEIGHT_OFFSET+y*DSO_CHAR_HEIGHT); tft->myDrawString(x,DSO_INFO_MAX_WIDTH);}    
-#define AND_ONE_F(x,y) { tft->setCursor(DSO_INFO_START_COLUMN+4, DSO_HEIGHT_OFFSET+y*DSO_CHAR_HEIGHT);prettyPrint(x,DSO_INFO_MAX_WIDTH);}    
+    int color=GREEN;
     if(stats.saturation)
-    {
-           tft->setTextColor(RED,BLACK);
-    }else
-    {
-           tft->setTextColor(GREEN,BLACK);
-    }
-    AND_ONE_F(stats.xmin,3);
-    AND_ONE_F(stats.xmax,5);
-    AND_ONE_F(stats.avg,1);      
-    tft->setTextColor(GREEN,BLACK);
+           color=RED;
+    minReadout.draw(prettyPrint(stats.xmin),color,BLACK);
+    maxReadout.draw(prettyPrint(stats.xmax),color,BLACK);
+    avgReadout.draw(prettyPrint(stats.avg),color,BLACK);
     if(stats.frequency>0)
     {
-        AND_ONE_T(fq2Text(stats.frequency),7);
+        freqReadout.draw(fq2Text(stats.frequency),GREEN,BLACK);
     }else
     {
-        AND_ONE_T("--",7);
+        freqReadout.draw("--",GREEN,BLACK);
     }
+    tft->setTextColor(GREEN,BLACK);
 }
 /**
  * 
@@ -258,6 +434,13 @@ void DSODisplay::drawStatsBackGround()
     AND_ONE_A("Offst",10);
     tft->setTextColor(BG_COLOR,BLACK);
     oldMode=DSO_CAPTURE_MODE_INVALIDE;
+    // the values may have been wiped, redraw them completely next time
+    avgReadout.invalidate();
+    minReadout.invalidate();
+    maxReadout.invalidate();
+    freqReadout.invalidate();
+    triggerReadout.invalidate();
+    offsetReadout.invalidate();
     
 }
 
@@ -267,7 +450,8 @@ void DSODisplay::drawStatsBackGround()
  */
 void  DSODisplay::printOffset(float volt)
 {
-    AND_ONE_F(volt,11);      
+    offsetReadout.draw(prettyPrint(volt),BG_COLOR,BLACK);
+    tft->setTextColor(BG_COLOR,BLACK);
 }
 
 /**
@@ -277,8 +461,8 @@ void  DSODisplay::printOffset(float volt)
  */
 void DSODisplay::printTriggerValue( float volt)
 {    
-    
-    AND_ONE_F(volt,9);      
+    triggerReadout.draw(prettyPrint(volt),BG_COLOR,BLACK);
+    tft->setTextColor(BG_COLOR,BLACK);
 }
 
 #define LOWER_BAR_PRINT(x,y) { tft->setCursor(y*64, 240-18); tft->myDrawString(x,64);}            
@@ -33,6 +33,14 @@ typedef enum
             TIME_MODE_ALT=TIME_MODE+0x80,
             TRIGGER_MODE_ALT=TRIGGER_MODE+0x80,
 }MODE_TYPE;
+/**
+ */
+typedef enum
+{
+            PERSISTENCE_OFF=0,
+            PERSISTENCE_DECAY=1,
+            PERSISTENCE_INFINITE=2
+}PERSISTENCE_MODE;
 
 public:
             
@@ -56,4 +64,8 @@ public:
             static void  drawAutoSetupStep(int x);
             static void  drawArmingMode(DSO_ArmingMode mode);
             static void  drawTriggeredState(DSO_ArmingMode mode,bool triggered);
+            
+            static void  setPersistence(PERSISTENCE_MODE p);
+            static PERSISTENCE_MODE getPersistence();
+            static void  clearPersistence(bool erase);
 };
\ No newline at end of file
@@ -7,9 +7,16 @@
 #include "dso_global.h"
 #include "dso_eeprom.h"
 #include "dso_adc_gain_priv.h"
+#include "dso_settingsRecord.h"
 extern uint16_t calibrationHash;
 
 #define FINE_TUNE_OFFSET 64
+// Linearity : hash at LINEARITY_OFFSET, then LINEARITY_KNOTS words per gain range
+// Only the corrected ranges are written, a missing word reads as 0 i.e. no correction
+#define LINEARITY_OFFSET 128
+#define LINEARITY_ADDRESS(range,knot) (LINEARITY_OFFSET+2+(range)*LINEARITY_KNOTS+(knot)) // up to 246
+// Settings : two slots of DSOSettingsRecord, 256 and 272
+#define SETTINGS_OFFSET  256
 #if 0
     #define CHECK_READ(x) xAssert(x)
 #else
@@ -75,6 +82,32 @@ bool  DSOEeprom::readFineVoltage()
     }
     return true;
 }
+/**
+ * 
+ * @return 
+ */
+bool  DSOEeprom::readLinearity()
+{
+    EEPROMClass e2;
+    addressInit(e2);
+    for(int i=0;i<DSO_NB_GAIN_RANGES;i++)
+        DSOInputGain::clearLinearity(i);
+    if(e2.read(LINEARITY_OFFSET)!=CURRENT_HASH)
+        return true;
+    for(int i=0;i<DSO_NB_GAIN_RANGES;i++)
+    {
+        int16_t *table=DSOInputGain::getLinearityTable(i);
+        for(int k=0;k<LINEARITY_KNOTS;k++)
+        {
+            uint16_t v;
+            if(EEPROM_OK!=e2.read(LINEARITY_ADDRESS(i,k),&v))
+                v=0;
+            table[k]=(int16_t)v;
+        }
+    }
+    DSOInputGain::setGainRange(DSOInputGain::getGainRange()); // refresh the current table
+    return true;
+}
 /**
  * 
  * @return 
@@ -97,6 +130,21 @@ bool  DSOEeprom::write()
             e2.write(FINE_TUNE_OFFSET+2+i*2+0,adr[0]);
             e2.write(FINE_TUNE_OFFSET+2+i*2+1,adr[1]);            
     }
+    e2.write(LINEARITY_OFFSET,CURRENT_HASH);
+    for(int i=0;i<DSO_NB_GAIN_RANGES;i++)
+    {
+        int16_t *table=DSOInputGain::getLinearityTable(i);
+        bool used=false;
+        for(int k=0;k<LINEARITY_KNOTS;k++)
+            if(table[k]) used=true;
+        for(int k=0;k<LINEARITY_KNOTS;k++)
+        {
+            uint16_t old;
+            // write uncorrected ranges only to clear a previous correction, saves flash
+            if(used || (EEPROM_OK==e2.read(LINEARITY_ADDRESS(i,k),&old) && old))
+                e2.write(LINEARITY_ADDRESS(i,k),(uint16_t)table[k]);
+        }
+    }
     calibrationHash=e2.write(0,CURRENT_HASH);
     return true;
 }
@@ -111,8 +159,51 @@ bool  DSOEeprom::wipe()
     e2.format();
     e2.write(0,0);
     e2.write(FINE_TUNE_OFFSET,0);
+    e2.write(LINEARITY_OFFSET,0);
     return true;
 }
+/**
+ * \class EepromWords
+ * \brief DSOWordStorage on top of the emulated eeprom
+ */
+class EepromWords : public DSOWordStorage
+{
+public:
+    EepromWords()
+    {
+        addressInit(_e2);
+    }
+    virtual bool read(int address, uint16_t &value)
+    {
+        return EEPROM_OK==_e2.read(address,&value);
+    }
+    virtual void write(int address, uint16_t value)
+    {
+        _e2.write(address,value);
+    }
+protected:
+    EEPROMClass _e2;
+};
+/**
+ * \fn readSettings
+ * @return false if there is no valid record of the current version
+ */
+bool  DSOEeprom::readSettings(DSOSettings &settings)
+{
+    EepromWords words;
+    return DSOSettingsRecord::read(words,SETTINGS_OFFSET,settings);
+}
+/**
+ * \fn writeSettings
+ * \brief See DSOSettingsRecord, a power off during the write falls back to the previous record
+ * The page rotation of the emulation does the wear levelling.
+ * @return number of words written
+ */
+int  DSOEeprom::writeSettings(const DSOSettings &settings)
+{
+    EepromWords words;
+    return DSOSettingsRecord::write(words,SETTINGS_OFFSET,settings);
+}
 bool  DSOEeprom::format()
 {
     EEPROMClass e2;
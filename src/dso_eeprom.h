@@ -4,12 +4,31 @@
  * (c) mean 2019 fixounet@free.fr
  ****************************************************/
 #pragma once
+#include <stdint.h>
+/**
+ * Scope settings, saved as a versioned record of 16 bits words
+ * Only append fields at the end and bump DSO_SETTINGS_VERSION 
+ */
+#define DSO_SETTINGS_VERSION 1
+typedef struct
+{
+    uint16_t timeBase;
+    uint16_t voltageRange;
+    uint16_t triggerMode;
+    uint16_t armingMode;
+    float    triggerValue;
+    float    voltageOffset;
+}DSOSettings;
+
 class DSOEeprom
 {
 public:
         static bool read();
         static bool readFineVoltage();
+        static bool readLinearity();
         static bool write();
         static bool wipe();  
         static bool format(); 
+        static bool readSettings(DSOSettings &settings);
+        static int  writeSettings(const DSOSettings &settings);
 };
\ No newline at end of file
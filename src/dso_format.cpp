@@ -0,0 +1,174 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#include "stdint.h"
+#include "dso_format.h"
+
+/**
+ * \fn printInt
+ * \brief write value in decimal, left padded with 0 up to minDigits
+ * @param out
+ * @param value
+ * @param minDigits
+ * @return pointer to the trailing 0
+ */
+char *DSOFormat::printInt(char *out, int value, int minDigits)
+{
+    char tmp[12];
+    int n=0;
+    unsigned int v;
+    if(value<0)
+    {
+        *out++='-';
+        v=-(unsigned int)value;
+    }else
+        v=value;
+    do
+    {
+        tmp[n++]='0'+(v%10);
+        v/=10;
+    }while(v);
+    while(n<minDigits && n<(int)sizeof(tmp)) 
+        tmp[n++]='0';
+    while(n)
+        *out++=tmp[--n];
+    *out=0;
+    return out;
+}
+/**
+ * \fn printFixed
+ * \brief print value/10^decimals with exactly decimals digits after the dot
+ */
+static char *printFixed(char *out, int value, int decimals)
+{
+    int scale=1;
+    for(int i=0;i<decimals;i++) scale*=10;
+    if(value<0)
+    {
+        *out++='-';
+        value=-value;
+    }
+    out=DSOFormat::printInt(out,value/scale,1);
+    *out++='.';
+    return DSOFormat::printInt(out,value%scale,decimals);
+}
+/**
+ * \fn frequency
+ * \brief Engineering notation with 1 decimal above 1 kHz
+ *  50 => "50", 1250 => "1.3k", 2500000 => "2.5M"
+ * @param fq in Hz
+ * @param out
+ * @return out
+ */
+const char *DSOFormat::frequency(int fq, char *out)
+{
+    char *p=out;
+    if(fq>=1000000)
+    {
+        p=printFixed(p,(fq+50000)/100000,1);
+        *p++='M';
+    }else if(fq>=1000)
+    {
+        int tenth=(fq+50)/100;
+        if(tenth>=10000) // 999.95k rounds up to 1.0M
+        {
+            p=printFixed(p,(tenth+500)/1000,1);
+            *p++='M';
+        }else
+        {
+            p=printFixed(p,tenth,1);
+            *p++='k';
+        }
+    }else
+    {
+        p=printInt(p,fq,1);
+    }
+    *p=0;
+    return out;
+}
+/**
+ * \fn voltage
+ * \brief same layout as the old %03du / %03dm / %02.2f readouts, rounded to nearest
+ * As with %03d the sign counts in the width : -0.012 => "-12m"
+ * @param volt
+ * @param out
+ * @return out
+ */
+const char *DSOFormat::voltage(float volt, char *out)
+{
+    // Only one float multiply, the rest is integer
+    float f=volt*1000000.f;
+    int micro=(int)(f<0 ? f-0.5f : f+0.5f);
+    int a=micro<0 ? -micro : micro;
+    int digits=micro<0 ? 2 : 3;
+    char *p=out;
+    if(a<1000)
+    {
+        p=printInt(p,micro,digits);
+        *p++='u';
+    }else if(a<800000)
+    {
+        int milli=(a+500)/1000;
+        if(micro<0) milli=-milli;
+        p=printInt(p,milli,digits);
+        *p++='m';
+    }else
+    {
+        int cent=(a+5000)/10000;
+        if(micro<0) cent=-cent;
+        p=printFixed(p,cent,2);
+    }
+    *p=0;
+    return out;
+}
+/**
+ * \fn scientific
+ * \brief SCPI NR3 layout with 5 significant digits, e.g. 5e-6 => "5.0000E-06"
+ * The value is normalized with float multiply/divide, the digits are integer
+ * NaN and infinity give the SCPI not a number, "9.91E+37"
+ * @param f
+ * @param out
+ * @return out
+ */
+const char *DSOFormat::scientific(float f, char *out)
+{
+    char *p=out;
+    if(!(f>=-3.4e38f && f<=3.4e38f))
+    {
+        const char *nan="9.91E+37";
+        while(*nan) *p++=*nan++;
+        *p=0;
+        return out;
+    }
+    if(f<0)
+    {
+        *p++='-';
+        f=-f;
+    }
+    int exponent=0;
+    if(f!=0)
+    {
+        while(f>=10.f) {f/=10.f;exponent++;}
+        while(f<1.f)   {f*=10.f;exponent--;}
+    }
+    int mantissa=(int)(f*10000.f+0.5f);
+    if(mantissa>=100000) // 9.99995 rounds up to 10.0000
+    {
+        mantissa=(mantissa+5)/10;
+        exponent++;
+    }
+    p=printFixed(p,mantissa,4);
+    *p++='E';
+    if(exponent<0)
+    {
+        *p++='-';
+        exponent=-exponent;
+    }else
+        *p++='+';
+    p=printInt(p,exponent,2);
+    *p=0;
+    return out;
+}
+// EOF
@@ -0,0 +1,22 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+/**
+ * \class DSOFormat
+ * \brief Integer only text formatting for the readouts
+ * Avoids pulling the float path of printf in the display refresh
+ * The output buffer must be at least DSO_FORMAT_BUFFER_SIZE bytes
+ */
+#define DSO_FORMAT_BUFFER_SIZE 16
+class DSOFormat
+{
+public:
+    static const char *frequency(int fq, char *out);  // 1234 => "1.2k"
+    static const char *voltage(float volt, char *out); // 0.0123 => "012m"
+    static const char *scientific(float f, char *out); // 0.0025 => "2.5000E-03"
+    static char       *printInt(char *out, int value, int minDigits);
+};
+// EOF
@@ -10,6 +10,10 @@
 //#include "gfx/dso_small_compressed.h"
 #include "gfx/dso150nb_compressed.h"
 #include "cpuID.h"
+#include "dso_render.h"
+#include "dso_eeprom.h"
+#include "dso_perf.h"
+#include "dso_rotary.h"
 
 extern void  autoSetup();
 extern void  menuManagement(void);
@@ -17,7 +21,11 @@ extern void  menuManagement(void);
 extern void splash(void);
 static void drawGrid(void);
 extern void dsoUsb_processNextCommand();
-extern void dsoUsb_sendData(int count,float *data, CaptureStats &stats);
+extern void bootCompleted();
+extern void bootPhase(const char *name);
+extern void bootLog();
+extern bool dsoUsb_sendData(int count,float *data, CaptureStats &stats);
+extern bool dsoUsb_streamData(int count,float *data, CaptureStats &stats);
 //--
 extern Adafruit_TFTLCD_8bit_STM32 *tft;
 extern DSOControl *controlButtons;
@@ -25,12 +33,9 @@ extern testSignal *myTestSignal;
 extern DSOADC   *adc;
 //
 float test_samples[256];
-static uint8_t waveForm[256]; // take a bit more, we have rounding issues
 
-uint32_t  refrshDuration=0;
-int       nbRefrsh=0;
 CaptureStats stats;    
-static    int lastTrigger=-1;
+static    int lastCount=0; // samples in test_samples, matching stats
 static    DSOControl::DSOCoupling oldCoupling;
 static    int triggered=0; // 0 means not trigger, else it is the # of samples in the buffer
 DSO_ArmingMode armingMode=DSO_CAPTURE_CONTINUOUS; // single shot or repeat capture
@@ -44,15 +49,23 @@ void uiRequestCapture(bool v )
 {
     if(v) // ask captured data
     {
-        usbCaptureRequested=false;
-#warning fixme : get the # of samples        
-        dsoUsb_sendData(240,test_samples,stats);
+        usbCaptureRequested=!dsoUsb_sendData(lastCount,test_samples,stats); // the last capture, as it was taken
     }else
     {
         usbCaptureRequested=true;
     }
 }
 
+/**
+ * \brief Last captured samples, in volt, and their stats
+ * @return number of samples
+ */
+int uiLastCapture(float **samples, CaptureStats **st)
+{
+    *samples=test_samples;
+    *st=&stats;
+    return lastCount;
+}
 /**
  * 
  */
@@ -85,15 +98,85 @@ void splash(void)
 
 
 
-static void redraw()
+/**
+ * \brief redraw the settings, clearPersistence if they changed
+ */
+static void redraw(bool clearPersistence=false)
 {
+        DSORender::lock();
+        if(clearPersistence)
+            DSODisplay::clearPersistence(true); // the old traces are no longer relevant
         DSODisplay::drawGrid();
         DSODisplay::printVoltTimeTriggerMode(capture->getVoltageRangeAsText(), capture->getTimeBaseAsText(),DSOCapture::getTriggerMode(),armingMode);
         DSODisplay::printTriggerValue(DSOCapture::getTriggerValue());
         DSODisplay::printOffset(capture->getVoltageOffset());
         //DSODisplay::drawArmingMode(armingMode,false);
+        DSORender::unlock();
 }
 #define STOP_CAPTURE() {DSOCapture::stopCapture();xDelay(20);}
+#define LIVE_TRIGGER_MS   300 // a trigger level change is live only if we triggered recently
+
+/**
+ * How a settings change reaches the acquisition
+ */
+enum SettingChange
+{
+    SETTING_DISPLAY, // only changes how the samples are drawn (offset), the capture goes on
+    SETTING_LIVE,    // read on the fly by the capture engine (trigger level), the capture goes on
+    SETTING_REARM    // the capture must be stopped and restarted (range, timebase, modes...)
+};
+static uint32_t lastCaptureTime=0; // millis() of the last successful capture
+
+/**
+ * \brief The trigger level is used when arming and when refining, so a new level is picked
+ * up by the next capture. But if we are stuck waiting for the old level, we must re-arm.
+ */
+static SettingChange triggerLevelChange()
+{
+    if(millis()-lastCaptureTime<LIVE_TRIGGER_MS)
+        return SETTING_LIVE;
+    return SETTING_REARM;
+}
+/**
+ * \brief To be called before modifying a setting, only stop the capture if needed
+ */
+static void prepareChange(SettingChange change)
+{
+    if(change==SETTING_REARM)
+        STOP_CAPTURE();
+}
+static bool rotaryAccelerated;
+static int pollRotary(int waitMs)
+{
+    xDelay(waitMs);
+    return controlButtons->getRotaryValue(rotaryAccelerated);
+}
+static uint32_t rotaryClock()
+{
+    return millis();
+}
+
+/**
+ * \fn readRotary
+ * \brief Collect a whole burst of detents, so a fast spin is one settings change 
+ * (and one capture restart) instead of one per detent, see DSORotary::burst
+ * Continuous values (offset, trigger level) get the accelerated count
+ */
+static int readRotary()
+{
+    switch(DSODisplay::getMode())
+    {
+        case DSODisplay::VOLTAGE_MODE_ALT:
+        case DSODisplay::TRIGGER_MODE_ALT:
+            rotaryAccelerated=true;
+            break;
+        default:
+            rotaryAccelerated=false;
+            break;
+    }
+    int inc=controlButtons->getRotaryValue(rotaryAccelerated);
+    return DSORotary::burst(inc,pollRotary,rotaryClock);
+}
 
 static void buttonManagement()
 {
@@ -117,9 +200,12 @@ static void buttonManagement()
    
     if(evt & EVENT_LONG_PRESS)    
     {
+        DSORender::lock();
         STOP_CAPTURE();
         autoSetup();
+        lastCount=0; // test_samples were overwritten by the auto setup captures
         drawBackground();        
+        DSORender::unlock();
         return;
     }
     // Rotary push
@@ -133,17 +219,14 @@ static void buttonManagement()
     }
     if(evt & EVENT_LONG_PRESS)    
     {
+        DSORender::lock();
         STOP_CAPTURE();
         menuManagement();
         drawBackground();
-        
+        DSORender::unlock();
         return;
     }
   
-    int inc=controlButtons->getRotaryValue();
-    
-    
-    
     if(controlButtons->getButtonEvents(DSOControl::DSO_BUTTON_VOLTAGE) & EVENT_SHORT_PRESS)
     {
         dirty=true;
@@ -166,11 +249,14 @@ static void buttonManagement()
     {
         if((DSODisplay::getMode()&0x7f)==newMode) // switch between normal & alternate
             newMode=(DSODisplay::MODE_TYPE)(DSODisplay::getMode()^0x80);
+        DSORender::lock();
         DSODisplay::setMode(newMode);
+        DSORender::unlock();
         redraw();
     }
     dirty=false;
 
+    int inc=readRotary();
     if(inc)
     {
 
@@ -183,7 +269,7 @@ static void buttonManagement()
                     v+=inc;
                     if(v<0) v=0;
                     if(v>DSO_ArmingMode::DSO_CAPTURE_CONTINUOUS) v=DSO_ArmingMode::DSO_CAPTURE_CONTINUOUS;
-                    STOP_CAPTURE();
+                    prepareChange(SETTING_REARM);
                     armingMode=(DSO_ArmingMode)v;
                     triggered=0;
                 }
@@ -196,7 +282,7 @@ static void buttonManagement()
                 v+=inc;
                 if(v<0) v=0;
                 if(v>DSOCapture::DSO_VOLTAGE_MAX) v=DSOCapture::DSO_VOLTAGE_MAX;
-                STOP_CAPTURE();
+                prepareChange(SETTING_REARM);
                 capture->setVoltageRange((DSOCapture::DSO_VOLTAGE_RANGE)v);                                
                 
                 }
@@ -210,7 +296,7 @@ static void buttonManagement()
                    if(v>DSOCapture::DSO_TIME_BASE_MAX) v=DSOCapture::DSO_TIME_BASE_MAX;
                    DSOCapture::DSO_TIME_BASE  t=(DSOCapture::DSO_TIME_BASE )v;
                    DSOCapture::clearCapturedData();
-                   STOP_CAPTURE();
+                   prepareChange(SETTING_REARM);
                    
                    capture->setTimeBase( t);
                    
@@ -222,7 +308,7 @@ static void buttonManagement()
                     t+=inc;
                     while(t<0) t+=4;
                     t%=4;
-                    STOP_CAPTURE();                    
+                    prepareChange(SETTING_REARM);
                     capture->setTriggerMode((DSOCapture::TriggerMode)t);                   
                     capture->setTimeBase( capture->getTimeBase()); // this will refresh the internal indirection table
                     dirty=true;
@@ -232,7 +318,7 @@ static void buttonManagement()
             {
                 float v=capture->getVoltageOffset();
                 v+=0.1*inc;
-                STOP_CAPTURE();
+                prepareChange(SETTING_DISPLAY);
                 capture->setVoltageOffset(v);                
                 dirty=true;
                 
@@ -246,7 +332,7 @@ static void buttonManagement()
                    float scale=capture->getVoltageRangeAsFloat(capture->getVoltageRange());
                    scale/=2.;
                    v+=scale*(float)inc;
-                   STOP_CAPTURE();
+                   prepareChange(triggerLevelChange());
                    capture->setTriggerValue(v);    
                    dirty=true;
                    
@@ -256,24 +342,35 @@ static void buttonManagement()
                             break;
         }       
     if(dirty)
-        redraw();
+        redraw(true);
     }
 }
+void uiSetTriggerVoltage(float f)
+{
+    prepareChange(triggerLevelChange());
+    capture->setTriggerValue(f);    
+    redraw(true);
+}
 void uiSetTriggerValue(int v)
 {
     float f=(float)v;
     f-=32768;
     f/=100.; // in volt
-    capture->setTriggerValue(f);    
-    redraw();
+    uiSetTriggerVoltage(f);
+}
+void uiSetVoltageOffset(float f)
+{
+    prepareChange(SETTING_DISPLAY);
+    capture->setVoltageOffset(f);
+    redraw(true);
 }
 void uiSetVoltage(int v)
 {
     if(v<0) v=0;
     if(v>DSOCapture::DSO_VOLTAGE_MAX) v=DSOCapture::DSO_VOLTAGE_MAX;
-    STOP_CAPTURE();
+    prepareChange(SETTING_REARM);
     capture->setVoltageRange((DSOCapture::DSO_VOLTAGE_RANGE)v);                          
-    redraw();
+    redraw(true);
 }
 void uiSetTimeBase(int v)
 {
@@ -281,16 +378,17 @@ void uiSetTimeBase(int v)
     if(v>DSOCapture::DSO_TIME_BASE_MAX) v=DSOCapture::DSO_TIME_BASE_MAX;
     DSOCapture::DSO_TIME_BASE  t=(DSOCapture::DSO_TIME_BASE )v;
     DSOCapture::clearCapturedData();
-    STOP_CAPTURE();
+    prepareChange(SETTING_REARM);
     capture->setTimeBase( t);
-    redraw();
+    redraw(true);
 }
 void uiSetTriggerMode(int v)
 {
     DSOCapture::TriggerMode t=(DSOCapture::TriggerMode)v;
+    prepareChange(SETTING_REARM);
     capture->setTriggerMode(t);                   
     capture->setTimeBase( capture->getTimeBase()); // this will refresh the internal indirection table
-    redraw();
+    redraw(true);
 }
 
 void uiSetArmingMode(int v)
@@ -299,10 +397,10 @@ void uiSetArmingMode(int v)
     if(v<0) v=0;
     if(v>DSO_ArmingMode::DSO_CAPTURE_CONTINUOUS) v=DSO_ArmingMode::DSO_CAPTURE_CONTINUOUS;
     DSO_ArmingMode mode=(DSO_ArmingMode)v;
-    STOP_CAPTURE();
+    prepareChange(SETTING_REARM);
     armingMode=mode;
     triggered=0; 
-    redraw();
+    redraw(true);
 }
 
 /**
@@ -311,6 +409,7 @@ void uiSetArmingMode(int v)
 void drawBackground()
 {
     tft->fillScreen(BLACK);
+    DSODisplay::clearPersistence(false);
     tft->setFontSize(Adafruit_TFTLCD_8bit_STM32::SmallFont);   
     tft->setTextSize(2);
     DSODisplay::drawGrid();
@@ -322,43 +421,96 @@ void drawBackground()
     //DSODisplay::drawArmingMode(armingMode,false);
 
 }
+
+#define SETTINGS_SAVE_DELAY 3000 // ms, the settings must be stable that long before being written
+static DSOSettings savedSettings;   // what is in flash
+static DSOSettings pendingSettings; // last seen
+static uint32_t    settingsChangedAt=0;
 /**
  * 
+ * @param s
+ */
+static void currentSettings(DSOSettings &s)
+{
+    memset(&s,0,sizeof(s));
+    s.timeBase=DSOCapture::getTimeBase();
+    s.voltageRange=DSOCapture::getVoltageRange();
+    s.triggerMode=DSOCapture::getTriggerMode();
+    s.armingMode=armingMode;
+    s.triggerValue=DSOCapture::getTriggerValue();
+    s.voltageOffset=DSOCapture::getVoltageOffset();
+}
+/**
+ * \brief Reject out of range values, e.g. a record from a firmware with more time bases
+ */
+static bool validFloat(float f)
+{
+    return f==f && f>-100. && f<100.;
+}
+static bool validSettings(const DSOSettings &s)
+{
+    return s.timeBase<=DSOCapture::DSO_TIME_BASE_MAX 
+        && s.voltageRange<=DSOCapture::DSO_VOLTAGE_MAX
+        && s.triggerMode<=DSOCapture::Trigger_Run
+        && s.armingMode<=DSO_CAPTURE_CONTINUOUS
+        && validFloat(s.triggerValue) && validFloat(s.voltageOffset);
+}
+/**
+ * \fn autoSaveSettings
+ * \brief Called from the main loop, write the settings once they have not moved 
+ * for SETTINGS_SAVE_DELAY, so a spin of the rotary is a single write
+ */
+static void autoSaveSettings()
+{
+    DSOSettings now;
+    currentSettings(now);
+    if(memcmp(&now,&pendingSettings,sizeof(now)))
+    {
+        pendingSettings=now; // still moving, restart the delay
+        settingsChangedAt=millis();
+        return;
+    }
+    if(!memcmp(&now,&savedSettings,sizeof(now)))
+        return;
+    if(millis()-settingsChangedAt<SETTINGS_SAVE_DELAY)
+        return;
+    DSOEeprom::writeSettings(now);
+    savedSettings=now;
+}
+/**
+ * \brief Resume where we were when switched off, defaults if nothing valid was saved
  */
 void initMainUI(void)
 {
-    DSOCapture::setTimeBase(    DSOCapture::DSO_TIME_BASE_1MS);
-    DSOCapture::setVoltageRange(DSOCapture::DSO_VOLTAGE_1V);
-    DSOCapture::setTriggerValue(1.);
+    DSOSettings s;
+    if(DSOEeprom::readSettings(s) && validSettings(s))
+    {
+        DSOCapture::setTriggerMode((DSOCapture::TriggerMode)s.triggerMode);
+        DSOCapture::setTimeBase((DSOCapture::DSO_TIME_BASE)s.timeBase);
+        DSOCapture::setVoltageRange((DSOCapture::DSO_VOLTAGE_RANGE)s.voltageRange);
+        DSOCapture::setTriggerValue(s.triggerValue); // after the range, the ADC value depends on it
+        DSOCapture::setVoltageOffset(s.voltageOffset);
+        armingMode=(DSO_ArmingMode)s.armingMode;
+    }else
+    {
+        DSOCapture::setTimeBase(    DSOCapture::DSO_TIME_BASE_1MS);
+        DSOCapture::setVoltageRange(DSOCapture::DSO_VOLTAGE_1V);
+        DSOCapture::setTriggerValue(1.);
+    }
+    currentSettings(savedSettings);
+    pendingSettings=savedSettings;
     drawBackground();    
     
     float f=DSOCapture::getTriggerValue();
     DSODisplay::printTriggerValue(f);
-    
-    lastTrigger=DSOCapture::voltageToPixel(f);
-    DSODisplay::drawVoltageTrigger(true,lastTrigger);
-    
 }
 /**
  *  called when nothing was captured, just in case the trigger value was changed
  */
-int triggerLine;
 void refreshTriggerIfNeedBe()
 {
-    float lastVoltageTrigger=DSOCapture::getTriggerValue()+DSOCapture::getVoltageOffset();            
     buttonManagement();
-    float f=DSOCapture::getTriggerValue()+DSOCapture::getVoltageOffset();
-    // did it change ?
-    if(f!=lastVoltageTrigger)
-    {
-        triggerLine=DSOCapture::voltageToPixel(lastVoltageTrigger);            
-        DSODisplay::drawVoltageTrigger(false,triggerLine);   
-        lastVoltageTrigger=f;                
-        triggerLine=DSOCapture::voltageToPixel(lastVoltageTrigger);     
-        if(triggered)
-            DSODisplay::drawWaveForm(triggered,waveForm);
-        DSODisplay::drawVoltageTrigger(true,triggerLine);   
-    }    
+    DSORender::updateTriggerLine(); // does nothing if it did not move
 }
 /**
  * 
@@ -367,52 +519,28 @@ void refreshTriggerIfNeedBe()
  */
 void processCapture(int count, CaptureStats &stats)
 {
-    static uint32_t lastRefresh=0;
     // So we captured something
-    // refresh the display
-
+    lastCaptureTime=millis();
+    lastCount=count;
     if(usbCaptureRequested)
     {
-        usbCaptureRequested=false;
-        dsoUsb_sendData(count,test_samples,stats);
-    }
-    
-    DSOCapture::captureToDisplay(count,test_samples,waveForm);  
-    // Remove trigger
-    DSODisplay::drawVoltageTrigger(false,triggerLine);        
-    DSODisplay::drawWaveForm(count,waveForm);
-    DSODisplay::drawTriggeredState(armingMode,triggered);        
-    
-    if(lastTrigger!=-1)
+        // not sent if a stream frame is still going out, then the next capture is
+        usbCaptureRequested=!dsoUsb_sendData(count,test_samples,stats);
+    }else
     {
-         DSODisplay::drawVerticalTrigger(false,lastTrigger);
-         lastTrigger=-1;
+        dsoUsb_streamData(count,test_samples,stats);
     }
-
-    if(stats.trigger!=-1)
+    // let the render task display it
+    DSORender::post(count,test_samples,stats);
+    static bool firstCapture=true;
+    if(firstCapture) // the render task has it, now we can spend time logging
     {
-        lastTrigger=stats.trigger;
-        DSODisplay::drawVerticalTrigger(true,lastTrigger);
+        firstCapture=false;
+        bootPhase("first waveform");
+        bootLog();
     }
+    DSORender::setTriggeredState(armingMode,triggered);
     buttonManagement();        
-
-    float f=DSOCapture::getTriggerValue()+DSOCapture::getVoltageOffset();
-    triggerLine=DSOCapture::voltageToPixel(f);
-    DSODisplay::drawVoltageTrigger(true,triggerLine);
-
-    // refresh the stats once in a while        
-    uint32_t m=millis();
-    if(m<lastRefresh)
-    {
-        m=lastRefresh+101;
-    }
-    if((m-lastRefresh)>250)
-    {
-        lastRefresh=m;
-        DSODisplay::drawStats(stats);
-        refrshDuration+=(millis()-m);
-        nbRefrsh++;
-    }
 }        
 
 /**
@@ -426,15 +554,17 @@ void mainDSOUI(void)
     DSODisplay::init();
     initMainUI();
     DSOADC::readVCCmv();
-    float f=DSOCapture::getTriggerValue()+DSOCapture::getVoltageOffset();
-    triggerLine=DSOCapture::voltageToPixel(f);
     DSOControl::DSOCoupling oldCoupling=controlButtons->getCouplingState();
-    float lastVoltageTrigger=-999;
+    DSORender::init();
+    DSORender::updateTriggerLine(); // draw the initial trigger line
     dso_usbInit();
+    bootCompleted();
     while(1)
     {        
         int count=0;  
         dsoUsb_processNextCommand();
+        autoSaveSettings();
+        DSOPerf::checkStacks();
         switch(armingMode)
         {
             case DSO_CAPTURE_MULTI:
@@ -445,12 +575,10 @@ void mainDSOUI(void)
                 if(!count) // Nothing captured, i.e. no trigger
                 {     
                     refreshTriggerIfNeedBe(); // this will call button management
-                    DSODisplay::drawTriggeredState(armingMode,triggered); // does nothing if no change
+                    DSORender::setTriggeredState(armingMode,triggered);
                     continue;
                 }
                 // capture successful !
-                // only update coupling when we have no capture running (i.e. we got something)
-                controlButtons->updateCouplingState();
                 // display it
                 processCapture(count,stats);
                 break;
@@ -458,9 +586,8 @@ void mainDSOUI(void)
                 // if triggered >0, it means we got a capture and wait to be rearmed
                 if(triggered)
                 {
-                    controlButtons->updateCouplingState(); // no capture running, we can update
                     refreshTriggerIfNeedBe(); // this will call button management
-                    DSODisplay::drawTriggeredState(armingMode,triggered); // does nothing if no change
+                    DSORender::setTriggeredState(armingMode,triggered);
                     // no need to redraw the actual capture
                     xDelay(10); // yield a bit
                     continue;
@@ -471,14 +598,12 @@ void mainDSOUI(void)
                     if(!count) // Nothing captured, i.e. no trigger
                     {     
                         refreshTriggerIfNeedBe(); // this will call button management
-                        DSODisplay::drawTriggeredState(armingMode,triggered); // does nothing if no change
+                        DSORender::setTriggeredState(armingMode,triggered);
                         xDelay(1); // yield a bit
                         continue;
                     }
-                    //
-                    controlButtons->updateCouplingState();
                     triggered=count; // got something, switch to waiting to be rearmed mode
-                    DSODisplay::drawTriggeredState(armingMode,triggered); // does nothing if no change
+                    DSORender::setTriggeredState(armingMode,triggered);
                     processCapture(count,stats);
                     break;
                 }
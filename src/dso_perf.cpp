@@ -0,0 +1,132 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#include "dso_global.h"
+#include "dso_perf.h"
+#include "DSO_config.h"
+
+#define OVERLAY_PERIOD_MS 1000
+#define OVERLAY_X         4
+#define OVERLAY_Y         (DSO_WAVEFORM_OFFSET+4)
+#define OVERLAY_LINE      18
+#define OVERLAY_WIDTH     (DSO_WAVEFORM_WIDTH-8)
+#define OVERLAY_LINES     6
+#define STACK_CHECK_PERIOD_MS 2000
+#define HEAP_MARGIN       256 // bytes
+
+extern "C" size_t xPortGetFreeHeapSize( void );
+extern void Logger(const char *fmt...);
+
+static volatile uint32_t perfCount[DSOPerf::PERF_LAST];
+static volatile uint32_t perfTime[DSOPerf::PERF_LAST];
+static bool              overlay=false;
+static uint32_t          lastOverlay=0;
+static char              lines[OVERLAY_LINES][32];
+static uint32_t          lastStackCheck=0;
+static const char       *taskNames[]={"MainTask","Control","Capture","Render","UsbControl","IDLE"};
+#define NB_TASKS (sizeof(taskNames)/sizeof(taskNames[0]))
+static uint32_t          lowStackReported=0; // one bit per task, so we report only once
+static bool              lowHeapReported=false;
+
+/**
+ * 
+ * @param counter
+ * @param us
+ */
+void DSOPerf::add(PerfCounter counter, uint32_t us)
+{
+    perfCount[counter]++;
+    perfTime[counter]+=us;
+}
+/**
+ * 
+ */
+void DSOPerf::toggleOverlay()
+{
+    overlay=!overlay;
+}
+/**
+ * 
+ * @return 
+ */
+bool DSOPerf::overlayEnabled()
+{
+    return overlay;
+}
+/**
+ * \brief free stack, in words, of the task with that name, -1 if not found
+ */
+static int stackLeft(const char *name)
+{
+    TaskHandle_t h=xTaskGetHandle(name);
+    if(!h) return -1;
+    return (int)uxTaskGetStackHighWaterMark(h);
+}
+/**
+ * \fn checkStacks
+ * \brief Called from the main loop, every STACK_CHECK_PERIOD_MS check the stack high water
+ * mark of all the tasks and the heap left. Running low is logged once per task,
+ * a stack overflow itself is caught by configCHECK_FOR_STACK_OVERFLOW
+ */
+void DSOPerf::checkStacks()
+{
+    uint32_t now=millis();
+    if(now-lastStackCheck<STACK_CHECK_PERIOD_MS) return;
+    lastStackCheck=now;
+    for(int i=0;i<(int)NB_TASKS;i++)
+    {
+        int left=stackLeft(taskNames[i]);
+        if(left<0 || left>=DSO_STACK_MARGIN || (lowStackReported & (1<<i)))
+            continue;
+        lowStackReported|=1<<i;
+        Logger("Stack low : %s %d words left\n",taskNames[i],left);
+    }
+    int heap=(int)xPortGetFreeHeapSize();
+    if(heap<HEAP_MARGIN && !lowHeapReported)
+    {
+        lowHeapReported=true;
+        Logger("Heap low : %d bytes left\n",heap);
+    }
+}
+/**
+ * \fn drawOverlay
+ * \brief Called by the render task after each frame.
+ * The figures are refreshed once per second, the text is redrawn every time
+ * as the waveform runs over it.
+ * Rates are per second, times are the average duration in us, stacks in words
+ */
+void DSOPerf::drawOverlay()
+{
+    if(!overlay) return;
+    uint32_t now=millis();
+    uint32_t elapsed=now-lastOverlay;
+    if(elapsed>=OVERLAY_PERIOD_MS)
+    {
+        lastOverlay=now;
+        uint32_t count[PERF_LAST],avg[PERF_LAST];
+        for(int i=0;i<PERF_LAST;i++)
+        {
+            count[i]=perfCount[i];
+            avg[i]=count[i] ? perfTime[i]/count[i] : 0;
+            perfCount[i]=0;
+            perfTime[i]=0;
+        }
+        sprintf(lines[0],"cap/s %d fps %d",(int)((count[PERF_CAPTURE]*1000)/elapsed),(int)((count[PERF_RENDER]*1000)/elapsed));
+        sprintf(lines[1],"capt %dus xform %dus",(int)avg[PERF_CAPTURE],(int)avg[PERF_TRANSFORM]);
+        sprintf(lines[2],"rndr %dus stat %dus",(int)avg[PERF_RENDER],(int)avg[PERF_STATS]);
+        sprintf(lines[3],"heap free %d",(int)xPortGetFreeHeapSize());
+        sprintf(lines[4],"stk M%d C%d A%d",stackLeft("MainTask"),stackLeft("Control"),stackLeft("Capture"));
+        sprintf(lines[5],"stk R%d U%d I%d",stackLeft("Render"),stackLeft("UsbControl"),stackLeft("IDLE"));
+    }
+    tft->setFontSize(Adafruit_TFTLCD_8bit_STM32::SmallFont);
+    tft->setTextColor(WHITE,BLACK);
+    for(int i=0;i<OVERLAY_LINES;i++)
+    {
+        tft->setCursor(OVERLAY_X, OVERLAY_Y+i*OVERLAY_LINE);
+        tft->myDrawString(lines[i],OVERLAY_WIDTH);
+    }
+    tft->setTextColor(GREEN,BLACK);
+}
+// EOF
@@ -0,0 +1,30 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+/**
+ * \class DSOPerf
+ * \brief Lightweight timing counters + the debug overlay that shows them
+ * Each counter accumulates the number of events and the time spent (us)
+ * The overlay is refreshed once per second by the render task
+ */
+class DSOPerf
+{
+public:
+    enum PerfCounter
+    {
+        PERF_CAPTURE=0,   // capture tasklet : trigger search, conversion, frequency
+        PERF_TRANSFORM=1, // samples to pixels
+        PERF_RENDER=2,    // one frame drawn
+        PERF_STATS=3,     // stats readouts
+        PERF_LAST
+    };
+    static void add(PerfCounter counter, uint32_t us);
+    static void drawOverlay();
+    static void toggleOverlay();
+    static bool overlayEnabled();
+    static void checkStacks();
+};
+// EOF
@@ -0,0 +1,62 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#include "dso_global.h"
+#include "dso_readout.h"
+
+/**
+ * 
+ * @param x
+ * @param y
+ * @param paddToPixels : the field is cleared up to that width
+ */
+DSOReadout::DSOReadout(int x, int y, int paddToPixels)
+{
+    _x=x;
+    _y=y;
+    _padd=paddToPixels;
+    invalidate();
+}
+/**
+ * \brief Forget what is on screen, next draw will redraw the whole field
+ */
+void DSOReadout::invalidate()
+{
+    _valid=false;
+    _fg=-1;
+    _bg=-1;
+    _last[0]=0;
+}
+/**
+ * \fn draw
+ * \brief Skip the common prefix with what is already on screen, redraw the remaining glyphs
+ * The font is proportional, so once a glyph changed everything after it
+ * may have moved and has to be redrawn. The padding clears the tail.
+ * @param st
+ * @param fg
+ * @param bg
+ */
+void DSOReadout::draw(const char *st, int fg, int bg)
+{
+    int same=0;
+    if(_valid && fg==_fg && bg==_bg)
+    {
+        while(same<DSO_READOUT_MAX_CHAR && st[same] && st[same]==_last[same]) 
+            same++;
+        if(st[same]==_last[same]) // both ended, nothing changed
+            return;
+    }
+    int offset=tft->myStringWidth(st,same);
+    tft->setTextColor(fg,bg);
+    tft->setCursor(_x+offset,_y);
+    tft->myDrawString(st+same,_padd-offset);
+    
+    strncpy(_last,st,DSO_READOUT_MAX_CHAR);
+    _last[DSO_READOUT_MAX_CHAR]=0;
+    _fg=fg;
+    _bg=bg;
+    _valid=true;
+}
+// EOF
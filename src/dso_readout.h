@@ -0,0 +1,27 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+
+#define DSO_READOUT_MAX_CHAR 15
+/**
+ * \class DSOReadout
+ * \brief Text field at a fixed position on screen
+ * It remembers the last string drawn and only redraws the glyphs
+ * starting at the first one that changed
+ */
+class DSOReadout
+{
+public:
+                DSOReadout(int x, int y, int paddToPixels);
+        void    draw(const char *st, int fg, int bg);
+        void    invalidate();
+protected:
+        int     _x,_y,_padd;
+        int     _fg,_bg;
+        bool    _valid;
+        char    _last[DSO_READOUT_MAX_CHAR+1];
+};
+// EOF
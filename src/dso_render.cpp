@@ -0,0 +1,210 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ * 
+ * Render task : the main loop deals with capture, buttons & usb and
+ * posts the result here. The frame mailbox only holds one frame,
+ * if the render task is late the older frame is just overwritten.
+ * 
+ ****************************************************/
+#include "dso_includes.h"
+#include "dso_render.h"
+#include "fancyLock.h"
+#include "dso_perf.h"
+#include "dso_static.h"
+
+#define RENDER_POLL_MS      50  // redraw the triggered state at least that often
+#define STATS_REFRESH_MS    250
+
+/**
+ */
+struct DSOFrame
+{
+    int           count;
+    int           triggerLine;  // horizontal trigger line, in pixel
+    CaptureStats  stats;
+    uint8_t       waveForm[256]; // take a bit more, we have rounding issues
+};
+
+static DSOFrame     mailbox;        // written by the main loop
+static DSOFrame     drawing;        // owned by the render task
+static bool         mailboxFull=false;
+static int          pendingTriggerLine=-1;
+static DSO_ArmingMode pendingArming=DSO_CAPTURE_CONTINUOUS;
+static bool         pendingTriggered=false;
+
+static xMutex         *frameLock=NULL;  // protects the pending* & mailbox
+static xMutex         *screenLock=NULL; // one task at a time on the screen
+static FancySemaphore *renderSemaphore=NULL;
+static TaskHandle_t   renderTaskHandle;
+static DSOStatic<xMutex>         frameLockStorage,screenLockStorage;
+static DSOStatic<FancySemaphore> renderSemaphoreStorage;
+DSO_STATIC_TASK(render,DSO_RENDER_TASK_STACK)
+
+// Render task private state
+static int          drawnTriggerLine=-1;
+static int          lastTrigger=-1;     // vertical trigger, in pixel
+static bool         hasDrawn=false;
+
+/**
+ * 
+ */
+void DSORender::init()
+{
+    frameLock=frameLockStorage.create();
+    screenLock=screenLockStorage.create();
+    renderSemaphore=renderSemaphoreStorage.create();
+    renderTaskHandle=xTaskCreateStatic( (TaskFunction_t)DSORender::task, "Render", DSO_RENDER_TASK_STACK, NULL, DSO_RENDER_TASK_PRIORITY, renderStack, &renderTcb );
+}
+/**
+ * 
+ */
+void DSORender::lock()
+{
+    if(screenLock) screenLock->lock();
+}
+/**
+ * 
+ */
+void DSORender::unlock()
+{
+    if(screenLock) screenLock->unlock();
+}
+/**
+ * \fn post
+ * \brief Convert the samples to pixels and hand them over to the render task
+ * This is done here, in the caller context, so that the current scale/offset are used
+ * @param count
+ * @param samples
+ * @param stats
+ */
+void DSORender::post(int count, float *samples, CaptureStats &stats)
+{
+    float f=DSOCapture::getTriggerValue()+DSOCapture::getVoltageOffset();
+    int line=DSOCapture::voltageToPixel(f);
+    
+    frameLock->lock();
+    DSOCapture::captureToDisplay(count,samples,mailbox.waveForm);
+    mailbox.count=count;
+    mailbox.stats=stats;
+    mailbox.triggerLine=line;
+    pendingTriggerLine=line;
+    mailboxFull=true;
+    frameLock->unlock();
+    renderSemaphore->give();
+}
+/**
+ * \fn updateTriggerLine
+ * \brief called when nothing was captured, just in case the trigger value was changed
+ */
+void DSORender::updateTriggerLine()
+{
+    float f=DSOCapture::getTriggerValue()+DSOCapture::getVoltageOffset();
+    int line=DSOCapture::voltageToPixel(f);
+    if(line==pendingTriggerLine) 
+        return;
+    frameLock->lock();
+    pendingTriggerLine=line;
+    frameLock->unlock();
+    renderSemaphore->give();
+}
+/**
+ * 
+ * @param mode
+ * @param triggered
+ */
+void DSORender::setTriggeredState(DSO_ArmingMode mode, bool triggered)
+{
+    // picked up at the next wake up, no need to hurry
+    pendingArming=mode;
+    pendingTriggered=triggered;
+}
+/**
+ * \brief Move the horizontal trigger line without a new capture
+ * The last waveform is redrawn as the line may have erased part of it
+ * @param line
+ */
+void DSORender::moveTriggerLine(int line)
+{
+    if(drawnTriggerLine>=0)
+        DSODisplay::drawVoltageTrigger(false,drawnTriggerLine);   
+    if(hasDrawn)
+        DSODisplay::drawWaveForm(drawing.count,drawing.waveForm);
+    drawnTriggerLine=line;
+    DSODisplay::drawVoltageTrigger(true,drawnTriggerLine);   
+}
+/**
+ * 
+ */
+void DSORender::drawFrame()
+{
+    static uint32_t lastRefresh=0;
+    uint32_t startUs=micros();
+    // Remove trigger
+    if(drawnTriggerLine>=0)
+        DSODisplay::drawVoltageTrigger(false,drawnTriggerLine);        
+    DSODisplay::drawWaveForm(drawing.count,drawing.waveForm);
+    hasDrawn=true;
+    
+    if(lastTrigger!=-1)
+    {
+         DSODisplay::drawVerticalTrigger(false,lastTrigger);
+         lastTrigger=-1;
+    }
+    if(drawing.stats.trigger!=-1)
+    {
+        lastTrigger=drawing.stats.trigger;
+        DSODisplay::drawVerticalTrigger(true,lastTrigger);
+    }
+    drawnTriggerLine=drawing.triggerLine;
+    DSODisplay::drawVoltageTrigger(true,drawnTriggerLine);
+
+    // refresh the stats once in a while        
+    uint32_t m=millis();
+    if(m<lastRefresh)
+    {
+        m=lastRefresh+101;
+    }
+    if((m-lastRefresh)>STATS_REFRESH_MS)
+    {
+        lastRefresh=m;
+        uint32_t statsUs=micros();
+        DSODisplay::drawStats(drawing.stats);
+        DSOPerf::add(DSOPerf::PERF_STATS,micros()-statsUs);
+    }
+    DSOPerf::add(DSOPerf::PERF_RENDER,micros()-startUs);
+}
+/**
+ * 
+ */
+void DSORender::task(void *)
+{
+    while(1)
+    {
+        renderSemaphore->take(RENDER_POLL_MS);
+        
+        frameLock->lock();
+        bool gotFrame=mailboxFull;
+        if(gotFrame)
+        {
+            drawing=mailbox;
+            mailboxFull=false;
+        }
+        int            line=pendingTriggerLine;
+        DSO_ArmingMode arming=pendingArming;
+        bool           triggered=pendingTriggered;
+        frameLock->unlock();
+        
+        screenLock->lock();
+        if(gotFrame)
+            drawFrame();
+        else if(line!=drawnTriggerLine && line>=0)
+            moveTriggerLine(line);
+        DSODisplay::drawTriggeredState(arming,triggered); // does nothing if no change
+        if(gotFrame)
+            DSOPerf::drawOverlay();
+        screenLock->unlock();
+    }
+}
+// EOF
@@ -0,0 +1,28 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+/**
+ * \class DSORender
+ * \brief Draws the captured waveforms in its own task
+ * The main loop posts frames, only the latest one is drawn.
+ * Anybody else drawing on the screen while the render task is running
+ * must do it between lock() and unlock()
+ */
+class DSORender
+{
+public:
+    static void init();
+    static void post(int count, float *samples, CaptureStats &stats);
+    static void updateTriggerLine();
+    static void setTriggeredState(DSO_ArmingMode mode, bool triggered);
+    static void lock();
+    static void unlock();
+protected:
+    static void task(void *);
+    static void drawFrame();
+    static void moveTriggerLine(int line);
+};
+// EOF
@@ -0,0 +1,83 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#include "dso_rle.h"
+
+/**
+ * 
+ * @param out receives the blocks
+ */
+DSORleEncoder::DSORleEncoder(DSORleWriter *out)
+{
+    _out=out;
+    _n=0;
+    _value=0;
+    _count=0;
+}
+/**
+ * \fn add
+ * \brief Next pixel of the line, 8 bits
+ */
+void DSORleEncoder::add(int pixel)
+{
+    if(_count && pixel==_value && _count<255)
+    {
+        _count++;
+        return;
+    }
+    flushRun();
+    _value=pixel;
+    _count=1;
+}
+/**
+ * 
+ */
+void DSORleEncoder::endLine()
+{
+    flushRun();
+}
+/**
+ * 
+ */
+void DSORleEncoder::end()
+{
+    flushRun();
+    flushBlock();
+    uint8_t zero=0;
+    _out(&zero,1);
+}
+/**
+ * \fn flushRun
+ * \brief Append the pending run to the block, a run is never split between blocks
+ */
+void DSORleEncoder::flushRun()
+{
+    if(!_count) return;
+    if(_n+3>DSO_RLE_BLOCK)
+        flushBlock();
+    if(_count>3 || _value==DSO_RLE_MARKER)
+    {
+        _block[1+_n++]=DSO_RLE_MARKER;
+        _block[1+_n++]=_value;
+        _block[1+_n++]=_count;
+    }
+    else
+    {
+        for(int i=0;i<_count;i++)
+            _block[1+_n++]=_value;
+    }
+    _count=0;
+}
+/**
+ * 
+ */
+void DSORleEncoder::flushBlock()
+{
+    if(!_n) return;
+    _block[0]=_n;
+    _out(_block,_n+1);
+    _n=0;
+}
+// EOF
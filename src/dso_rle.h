@@ -0,0 +1,35 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+#include <stdint.h>
+/**
+ * \class DSORleEncoder
+ * \brief RLE encoder for the screenshot, same scheme as the bitmaps (gfx/convert.py) :
+ * runs longer than 3 or of the marker value itself are escaped as marker value count,
+ * the others are sent as is. Runs never span two lines.
+ * The output is cut in blocks : 1 byte length (1..DSO_RLE_BLOCK) + data, a zero length
+ * block ends the stream
+ */
+#define DSO_RLE_MARKER  0x76
+#define DSO_RLE_BLOCK   64
+typedef void DSORleWriter(const uint8_t *data, int len);
+class DSORleEncoder
+{
+public:
+            DSORleEncoder(DSORleWriter *out);
+    void    add(int pixel);
+    void    endLine();      // close the current run
+    void    flushBlock();   // write the partial block, e.g. before a pause in the output
+    void    end();          // flush and write the end block
+protected:
+    void    flushRun();
+    DSORleWriter *_out;
+    uint8_t _block[DSO_RLE_BLOCK+1]; // length + data
+    int     _n;
+    int     _value;
+    int     _count;
+};
+// EOF
@@ -0,0 +1,51 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ *
+ * Rotary encoder acceleration & burst coalescing, no dependency on the
+ * hardware so it can be replayed on the host
+ ****************************************************/
+#include "dso_rotary.h"
+
+// Rotary acceleration : a detent coming less than x ms after the previous one is worth y
+#define ROTARY_FAST_MS        25
+#define ROTARY_FAST_STEP      4
+#define ROTARY_MEDIUM_MS      60
+#define ROTARY_MEDIUM_STEP    2
+
+/**
+ * \fn accelStep
+ * \brief Accelerated value of one detent, the faster the spin the bigger the step
+ * @param deltaMs : time since the previous detent
+ */
+int DSORotary::accelStep(uint32_t deltaMs)
+{
+    if(deltaMs<ROTARY_FAST_MS)   return ROTARY_FAST_STEP;
+    if(deltaMs<ROTARY_MEDIUM_MS) return ROTARY_MEDIUM_STEP;
+    return 1;
+}
+
+/**
+ * \fn burst
+ * \brief Collect a whole burst of detents : poll every ROTARY_BURST_GAP ms until one
+ * poll comes back empty, but no longer than ROTARY_BURST_MAX
+ * @param first : detents already read, 0 means no burst
+ * @return the sum of all the detents of the burst
+ */
+int DSORotary::burst(int first, RotaryPoll *poll, RotaryClock *now)
+{
+    if(!first)
+        return 0;
+    int inc=first;
+    uint32_t start=now();
+    while(now()-start<ROTARY_BURST_MAX)
+    {
+        int more=poll(ROTARY_BURST_GAP);
+        if(!more)
+            break;
+        inc+=more;
+    }
+    return inc;
+}
+// EOF
@@ -0,0 +1,25 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+#include <stdint.h>
+
+#define ROTARY_BURST_GAP  15  // ms, a burst ends when no detent came during that time
+#define ROTARY_BURST_MAX  150 // ms, but we dont wait more than that to react
+
+typedef int      RotaryPoll(int waitMs); // wait that long, then return the detents since the previous call
+typedef uint32_t RotaryClock();          // ms
+
+/**
+ * \class DSORotary
+ * \brief Rotary acceleration & burst coalescing, no dependency on the hardware
+ */
+class DSORotary
+{
+public:
+    static int accelStep(uint32_t deltaMs);
+    static int burst(int first, RotaryPoll *poll, RotaryClock *now);
+};
+// EOF
@@ -0,0 +1,210 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ *
+ * SCPI parser, no dependency on the hardware so it can
+ * be built and exercised on the host
+ ****************************************************/
+#include "dso_scpi.h"
+
+static inline char upper(char c)
+{
+    if(c>='a' && c<='z') return c-'a'+'A';
+    return c;
+}
+static inline bool isSpace(char c)
+{
+    return c==' ' || c=='\t' || c=='\r' || c=='\n';
+}
+static inline bool isDigit(char c)
+{
+    return c>='0' && c<='9';
+}
+/**
+ * \brief Match one node, e.g. "TIMebase" against "tim" or "TimeBase"
+ * The short form is the leading upper case part of the pattern
+ */
+static bool matchNode(const char *pattern, int patternLen, const char *in, int inLen)
+{
+    // numeric suffix, only 1 since we have a single channel
+    int suffix=inLen;
+    while(suffix>0 && isDigit(in[suffix-1]))
+        suffix--;
+    if(suffix!=inLen)
+    {
+        if(inLen-suffix!=1 || in[suffix]!='1')
+            return false;
+        inLen=suffix;
+    }
+    int shortLen=0;
+    while(shortLen<patternLen && (pattern[shortLen]<'a' || pattern[shortLen]>'z'))
+        shortLen++;
+    if(inLen!=shortLen && inLen!=patternLen)
+        return false;
+    for(int i=0;i<inLen;i++)
+        if(upper(in[i])!=upper(pattern[i]))
+            return false;
+    return true;
+}
+/**
+ * \fn matchHeader
+ * \brief Match a header (without the trailing '?') against a table pattern
+ * The leading ':' is optional
+ */
+bool DSOScpi::matchHeader(const char *pattern, const Token &header)
+{
+    const char *in=header.text;
+    const char *inEnd=in+header.len;
+    if(*pattern==':') pattern++;
+    if(in<inEnd && *in==':') in++;
+    while(1)
+    {
+        const char *p=pattern;
+        while(*p && *p!=':') p++;
+        const char *i=in;
+        while(i<inEnd && *i!=':') i++;
+        if(!matchNode(pattern,p-pattern,in,i-in))
+            return false;
+        if(!*p || i==inEnd) // both must end together
+            return !*p && i==inEnd;
+        pattern=p+1;
+        in=i+1;
+    }
+}
+/**
+ * \fn toFloat
+ * \brief Parse a SCPI decimal number : [+-]digits[.digits][E[+-]digits]
+ * Hand made as strtod would pull a lot of code and use the reent structure
+ * @return false if the whole token is not a number
+ */
+bool DSOScpi::toFloat(const Token &arg, float &f)
+{
+    const char *p=arg.text;
+    const char *end=p+arg.len;
+    bool negative=false;
+    float value=0;
+    int   digits=0;
+    if(p<end && (*p=='+' || *p=='-'))
+    {
+        negative=(*p=='-');
+        p++;
+    }
+    while(p<end && isDigit(*p))
+    {
+        value=value*10.f+(float)(*p++-'0');
+        digits++;
+    }
+    if(p<end && *p=='.')
+    {
+        p++;
+        float scale=0.1f;
+        while(p<end && isDigit(*p))
+        {
+            value+=scale*(float)(*p++-'0');
+            scale*=0.1f;
+            digits++;
+        }
+    }
+    if(!digits)
+        return false;
+    if(p<end && upper(*p)=='E')
+    {
+        p++;
+        bool negativeExponent=false;
+        int  exponent=0;
+        if(p<end && (*p=='+' || *p=='-'))
+        {
+            negativeExponent=(*p=='-');
+            p++;
+        }
+        if(p==end || !isDigit(*p))
+            return false;
+        while(p<end && isDigit(*p))
+            exponent=exponent*10+(*p++-'0');
+        if(exponent>38)
+            return false;
+        while(exponent--)
+        {
+            if(negativeExponent) value/=10.f;
+            else                 value*=10.f;
+        }
+    }
+    if(p!=end)
+        return false;
+    f=negative ? -value : value;
+    return true;
+}
+/**
+ * \fn execute
+ * \brief Run all the commands of a line
+ * @param queriesOnly : commands that are not queries fail with ERR_SETTINGS_CONFLICT
+ * @return ERR_NONE or the first error met, the remaining commands are not executed
+ */
+int DSOScpi::execute(const char *line, int len, const Command *table, int nbCommands, bool queriesOnly)
+{
+    const char *p=line;
+    const char *end=line+len;
+    while(p<end)
+    {
+        // one command, up to ';'
+        const char *cmdEnd=p;
+        while(cmdEnd<end && *cmdEnd!=';') cmdEnd++;
+        while(p<cmdEnd && isSpace(*p)) p++;
+        if(p<cmdEnd)
+        {
+            Token header;
+            header.text=p;
+            while(p<cmdEnd && !isSpace(*p) && *p!='?') p++;
+            header.len=p-header.text;
+            bool query=false;
+            if(p<cmdEnd && *p=='?')
+            {
+                query=true;
+                p++;
+            }
+            Token arg;
+            while(p<cmdEnd && isSpace(*p)) p++;
+            const char *argEnd=cmdEnd;
+            while(argEnd>p && isSpace(argEnd[-1])) argEnd--;
+            arg.text=p;
+            arg.len=argEnd-p;
+
+            int found=-1;
+            for(int i=0;i<nbCommands && found<0;i++)
+                if(matchHeader(table[i].header,header))
+                    found=i;
+            if(found<0)
+                return ERR_UNDEFINED_HEADER;
+            if(queriesOnly && !query)
+                return ERR_SETTINGS_CONFLICT;
+            int er=table[found].handler(query,arg);
+            if(er!=ERR_NONE)
+                return er;
+        }
+        p=cmdEnd+1;
+    }
+    return ERR_NONE;
+}
+/**
+ *
+ * @param error
+ * @return SCPI style error string, without the code
+ */
+const char *DSOScpi::errorText(int error)
+{
+    switch(error)
+    {
+        case ERR_NONE:              return "No error";
+        case ERR_COMMAND:           return "Command error";
+        case ERR_DATA_TYPE:         return "Data type error";
+        case ERR_MISSING_PARAMETER: return "Missing parameter";
+        case ERR_UNDEFINED_HEADER:  return "Undefined header";
+        case ERR_SETTINGS_CONFLICT: return "Settings conflict";
+        case ERR_DATA_OUT_OF_RANGE: return "Data out of range";
+        case ERR_TOO_MUCH_DATA:     return "Too much data";
+        case ERR_QUERY:             return "Query error";
+        default:                    return "Unknown error";
+    }
+}
+// EOF
@@ -0,0 +1,56 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+/**
+ * \class DSOScpi
+ * \brief Minimal SCPI parser
+ * The line is never copied nor modified, tokens are just (pointer, length) into it
+ * so parsing a command costs no allocation and a few words of stack.
+ *
+ * Supported syntax :
+ *      header[?] [argument] [; header[?] [argument]]...
+ * Headers are matched against the table with the SCPI short/long form rule, e.g.
+ * ":TIMebase:SCALe" matches ":TIM:SCAL", "timebase:scale" ... A numeric suffix of 1
+ * is accepted on any node (CHANnel1). Each command of a compound line starts at the root.
+ */
+class DSOScpi
+{
+public:
+    enum ScpiError
+    {
+        ERR_NONE=0,
+        ERR_COMMAND=-100,
+        ERR_DATA_TYPE=-104,
+        ERR_MISSING_PARAMETER=-109,
+        ERR_UNDEFINED_HEADER=-113,
+        ERR_SETTINGS_CONFLICT=-221, // cannot be applied now, e.g. a menu is open
+        ERR_DATA_OUT_OF_RANGE=-222,
+        ERR_TOO_MUCH_DATA=-223,    // the replies of the line do not fit in the output buffer
+        ERR_QUERY=-400         // query on a command only, or the reverse
+    };
+    typedef struct
+    {
+        const char *text;
+        int         len;
+    }Token;
+    /**
+     * @param query : the header ended with '?'
+     * @param arg   : argument, len==0 if none
+     * @return ERR_NONE or a ScpiError
+     */
+    typedef int (*Handler)(bool query, const Token &arg);
+    typedef struct
+    {
+        const char *header;     // full path in short/long form, e.g. ":TIMebase:SCALe" or "*IDN"
+        Handler     handler;
+    }Command;
+
+    static int  execute(const char *line, int len, const Command *table, int nbCommands, bool queriesOnly=false);
+    static bool matchHeader(const char *pattern, const Token &header);
+    static bool toFloat(const Token &arg, float &f);
+    static const char *errorText(int error);
+};
+// EOF
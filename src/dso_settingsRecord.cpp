@@ -0,0 +1,101 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ *
+ * Settings record, no dependency on the hardware so it can
+ * be built and exercised on the host
+ ****************************************************/
+#include <string.h>
+#include "dso_settingsRecord.h"
+
+static_assert(DSO_SETTINGS_SLOT_WORDS<=DSO_SETTINGS_SLOT_SPAN,"settings slots overlap");
+
+/**
+ * \brief crc16-ccitt, to reject a record partially written
+ */
+uint16_t DSOSettingsRecord::crc(const uint16_t *words, int nb)
+{
+    uint16_t crc=0xffff;
+    for(int i=0;i<nb*2;i++)
+    {
+        crc^=((const uint8_t *)words)[i]<<8;
+        for(int j=0;j<8;j++)
+            crc=(crc&0x8000)? (crc<<1)^0x1021 : crc<<1;
+    }
+    return crc;
+}
+/**
+ * \fn readSlot
+ * @return false if the slot does not hold a complete record of the current version
+ */
+bool DSOSettingsRecord::readSlot(DSOWordStorage &store, int address, uint16_t *words)
+{
+    for(int i=0;i<DSO_SETTINGS_SLOT_WORDS;i++)
+        if(!store.read(address+i,words[i]))
+            return false;
+    if(words[0]!=DSO_SETTINGS_VERSION)
+        return false;
+    return words[DSO_SETTINGS_SLOT_WORDS-1]==crc(words,DSO_SETTINGS_SLOT_WORDS-1);
+}
+/**
+ * \fn newest
+ * \brief Find the most recent valid slot, the sequence wraps around
+ * @param words : receives its content
+ * @return slot index, -1 if none
+ */
+int DSOSettingsRecord::newest(DSOWordStorage &store, int offset, uint16_t *words)
+{
+    uint16_t other[DSO_SETTINGS_SLOT_WORDS];
+    bool valid0=readSlot(store,offset,words);
+    bool valid1=readSlot(store,offset+DSO_SETTINGS_SLOT_SPAN,other);
+    if(valid1 && (!valid0 || (int16_t)(other[1]-words[1])>0))
+    {
+        memcpy(words,other,sizeof(other));
+        return 1;
+    }
+    return valid0 ? 0 : -1;
+}
+/**
+ * \fn read
+ * @return false if there is no valid record of the current version
+ */
+bool DSOSettingsRecord::read(DSOWordStorage &store, int offset, DSOSettings &settings)
+{
+    uint16_t words[DSO_SETTINGS_SLOT_WORDS];
+    if(newest(store,offset,words)<0)
+        return false;
+    memcpy(&settings,words+2,sizeof(settings));
+    return true;
+}
+/**
+ * \fn write
+ * \brief Write the record over the older slot, the crc last, so the newest one stays
+ * valid until the new one is complete. Words already holding the right value are
+ * skipped, the emulated eeprom appends an entry for each write.
+ * @return number of words written, 0 if the settings were already saved
+ */
+int DSOSettingsRecord::write(DSOWordStorage &store, int offset, const DSOSettings &settings)
+{
+    uint16_t words[DSO_SETTINGS_SLOT_WORDS];
+    int slot=newest(store,offset,words);
+    if(slot>=0 && !memcmp(words+2,&settings,sizeof(settings)))
+        return 0;
+    uint16_t sequence=(slot>=0) ? words[1]+1 : 0;
+    int address=offset+((slot==0) ? DSO_SETTINGS_SLOT_SPAN : 0);
+    words[0]=DSO_SETTINGS_VERSION;
+    words[1]=sequence;
+    memcpy(words+2,&settings,sizeof(settings));
+    words[DSO_SETTINGS_SLOT_WORDS-1]=crc(words,DSO_SETTINGS_SLOT_WORDS-1);
+    int written=0;
+    for(int i=0;i<DSO_SETTINGS_SLOT_WORDS;i++)
+    {
+        uint16_t old;
+        if(store.read(address+i,old) && old==words[i])
+            continue;
+        store.write(address+i,words[i]);
+        written++;
+    }
+    return written;
+}
+// EOF
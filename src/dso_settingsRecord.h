@@ -0,0 +1,40 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+#include <stdint.h>
+#include "dso_eeprom.h"
+/**
+ * \class DSOWordStorage
+ * \brief 16 bits words addressed by number, i.e. what the emulated eeprom offers
+ * Writing one word is atomic, a record of several words is not
+ */
+class DSOWordStorage
+{
+public:
+    virtual bool read(int address, uint16_t &value)=0; // false if never written
+    virtual void write(int address, uint16_t value)=0;
+};
+/**
+ * \class DSOSettingsRecord
+ * \brief Settings saved in two alternating slots so that a torn write (power off in
+ * the middle of it) never loses them : the new record goes over the older slot and
+ * the reader takes the valid slot with the highest sequence.
+ * Slot : version, sequence, words of DSOSettings, crc16 of all that
+ */
+#define DSO_SETTINGS_WORDS      ((int)(sizeof(DSOSettings)/2))
+#define DSO_SETTINGS_SLOT_WORDS (2+DSO_SETTINGS_WORDS+1)
+#define DSO_SETTINGS_SLOT_SPAN  16 // words between the two slots
+class DSOSettingsRecord
+{
+public:
+    static bool     read(DSOWordStorage &store, int offset, DSOSettings &settings);
+    static int      write(DSOWordStorage &store, int offset, const DSOSettings &settings);
+    static uint16_t crc(const uint16_t *words, int nb);
+protected:
+    static int      newest(DSOWordStorage &store, int offset, uint16_t *words);
+    static bool     readSlot(DSOWordStorage &store, int address, uint16_t *words);
+};
+// EOF
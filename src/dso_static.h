@@ -0,0 +1,35 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+#include <stdint.h>
+#include <new>
+/**
+ * \class DSOStatic
+ * \brief Static storage for an object that lives until power off
+ * The object is still built explicitly with create() so that the construction
+ * order at boot does not change, but the memory is in .bss : it shows up in the
+ * RAM budget report and running out of it is a link error, not a runtime one.
+ * create() must be called only once.
+ */
+template <class T> class DSOStatic
+{
+public:
+    template <typename... Args> T *create(Args... args)
+    {
+        return new(storage) T(args...);
+    }
+protected:
+    uint8_t storage[sizeof(T)] __attribute__((aligned(8)));
+};
+
+/**
+ * \brief Declare the stack & control block of a statically allocated task
+ *  to be used with xTaskCreateStatic(..., name##Stack, &name##Tcb)
+ */
+#define DSO_STATIC_TASK(name,stackWords) \
+    static StackType_t  name##Stack[stackWords]; \
+    static StaticTask_t name##Tcb;
+// EOF
@@ -6,13 +6,28 @@ USBCompositeSerial CompositeSerial;
 
 
 #define MKFCC(a,b,c,d) ( (a<<24)+(b<<16)+(c<<8)+d)
+#define USB_POLL_ACTIVE_MS   1     // poll period while the host is talking to us
+#define USB_POLL_IDLE_MS     20    // poll period when nothing happened recently
+#define USB_ACTIVE_WINDOW_MS 1000  // stay in fast poll that long after the last byte
+
 /**
- * 
+ * \brief Poll period, short while the host is active, longer when idle
+ */
+static int pollDelay(uint32_t lastActivity)
+{
+    if((millis()-lastActivity)<USB_ACTIVE_WINDOW_MS)
+        return USB_POLL_ACTIVE_MS;
+    return USB_POLL_IDLE_MS;
+}
+/**
+ * The serial layer only offers polling, so we poll but at each wake up we consume
+ * everything that has been received, i.e. a command does not wait for 4 wake ups
  */
 void UsbTask::run()
 {
     uint32_t magicWord;
     int      magicCount;
+    uint32_t lastActivity=0;
     while(1)
     {
         switch(_connected)
@@ -22,6 +37,7 @@ void UsbTask::run()
                 {
                     _connected=Handshaking;
                     magicWord=0;
+                    lastActivity=millis();
                     Logger("Plugged\n");
                     continue;
                 }
@@ -29,9 +45,19 @@ void UsbTask::run()
                 break;     
             case Handshaking:
                 if(!CompositeSerial.isConnected()) {   _connected=Disconnected;Logger("Disconnected\n");continue;   }
-                if(CompositeSerial.available())
+                while(_connected==Handshaking && CompositeSerial.available())
                 {
                     int n=CompositeSerial.read();
+                    lastActivity=millis();
+                    if(isTextStart(n)) // SCPI host, no handshake
+                    {
+                        Logger("Connected (text)\n");
+                        _connected=Connected;
+                        magicWord=0;
+                        magicCount=0;
+                        textByte(n);
+                        break;
+                    }
                     magicWord=(magicWord<<8)+n;
                     if(magicWord==MKFCC('D','S','O','0'))
                     {
@@ -40,17 +66,30 @@ void UsbTask::run()
                         _connected=Connected;
                         magicWord=0;
                         magicCount=0;
-                        continue;
                     }
                 }
-                xDelay(100);
+                xDelay(pollDelay(lastActivity));
                 break;
             case Connected:
                 if(!CompositeSerial.isConnected()) {   _connected=Disconnected;Logger("Disconnected\n");continue;   }
                 
-                if(CompositeSerial.available())
+                if(_frameIndex>=0 && (millis()-lastActivity)>DSOUSB_FRAME_TIMEOUT_MS)
+                    _frameIndex=-1; // the rest of the frame never came
+                // while a frame is being processed, leave the next bytes in the serial buffer
+                while(!_frameBusy && CompositeSerial.available())
                 {
                     int n=CompositeSerial.read();
+                    lastActivity=millis();
+                    if(_frameIndex>=0 || (!magicCount && n==DSOUSB_FRAME_SYNC))
+                    {
+                        frameByte(n);
+                        continue;
+                    }
+                    if(_textIndex!=-1 || (!magicCount && isTextStart(n)))
+                    {
+                        textByte(n);
+                        continue;
+                    }
                     magicWord=(magicWord<<8)+n;
                     magicCount++;
                     if(magicCount==4)
@@ -59,10 +98,8 @@ void UsbTask::run()
                         magicWord=0;
                         magicCount=0;
                     }
-                    
                 }
-                
-                xDelay(100);
+                xDelay(pollDelay(lastActivity));
                 break;
             default:
                 xAssert(0);
@@ -88,5 +125,141 @@ void UsbTask::writeFloat(const float f)
     uint8_t *c=(uint8_t *)&f;   
     CompositeSerial.write(c,4);
 }
+/**
+ * \fn frameByte
+ * \brief Accumulate one byte of a framed command, validate it when complete
+ */
+void UsbTask::frameByte(int c)
+{
+    if(_frameIndex<0) 
+        _frameIndex=0;
+    _frame[_frameIndex++]=c;
+    if(_frameIndex<DSOUSB_FRAME_HEADER) 
+        return;
+    if(_frameIndex==DSOUSB_FRAME_HEADER)
+    {
+        if(_frame[1]!=DSOUSB_FRAME_VERSION)
+        {
+            frameError(FRAME_ERROR_VERSION);
+            return;
+        }
+        if(_frame[3]>DSOUSB_FRAME_MAX_PAYLOAD)
+        {
+            frameError(FRAME_ERROR_LENGTH);
+            return;
+        }
+    }
+    int len=_frame[3];
+    if(_frameIndex<DSOUSB_FRAME_HEADER+len+2)
+        return;
+    _frameIndex=-1;
+    uint16_t crc=_frame[DSOUSB_FRAME_HEADER+len]+(_frame[DSOUSB_FRAME_HEADER+len+1]<<8);
+    if(crc!=crc16(_frame+1,DSOUSB_FRAME_HEADER-1+len))
+    {
+        frameError(FRAME_ERROR_CRC);
+        return;
+    }
+    _frameBusy=true;
+    processFrame(_frame[2],len,framePayload());
+}
+/**
+ * \fn textByte
+ * \brief Accumulate one byte of a SCPI line, hand it over on '\n'
+ */
+void UsbTask::textByte(int c)
+{
+    if(_textIndex==-1)
+        _textIndex=0;
+    if(c=='\n')
+    {
+        if(_textIndex<0)
+        {
+            Logger("Text line too long, dropped\n");
+            _textIndex=-1;
+            return;
+        }
+        _text[_textIndex]=0;
+        _textLength=_textIndex;
+        _textIndex=-1;
+        _frameBusy=true;
+        processText(_text,_textLength);
+        return;
+    }
+    if(_textIndex<0 || c=='\r')
+        return;
+    if(_textIndex>=DSOUSB_TEXT_MAX)
+    {
+        _textIndex=-2;
+        return;
+    }
+    _text[_textIndex++]=c;
+}
+/**
+ * 
+ * @param error
+ */
+void UsbTask::frameError(int error)
+{
+    Logger("Bad frame, error %d\n",error);
+    _frameIndex=-1;
+    processFrameError(error);
+}
+/**
+ * \brief The USB lock must be held
+ */
+void UsbTask::writeFrame(int opcode, int len, const uint8_t *payload)
+{
+    uint8_t head[DSOUSB_FRAME_HEADER]={DSOUSB_FRAME_SYNC,DSOUSB_FRAME_VERSION,(uint8_t)opcode,(uint8_t)len};
+    uint16_t crc=crc16(head+1,DSOUSB_FRAME_HEADER-1);
+    crc=crc16(payload,len,crc);
+    uint8_t tail[2]={(uint8_t)(crc&0xff),(uint8_t)(crc>>8)};
+    CompositeSerial.write(head,DSOUSB_FRAME_HEADER);
+    if(len)
+        CompositeSerial.write(payload,len);
+    CompositeSerial.write(tail,2);
+}
+/**
+ * \brief CRC16 CCITT, bitwise, frames are small
+ * Chain calls by passing the previous result as crc
+ */
+uint16_t UsbTask::crc16(const uint8_t *data, int len, uint16_t crc)
+{
+    for(int i=0;i<len;i++)
+    {
+        crc^=((uint16_t)data[i])<<8;
+        for(int j=0;j<8;j++)
+        {
+            if(crc&0x8000)
+                crc=(crc<<1)^0x1021;
+            else
+                crc<<=1;
+        }
+    }
+    return crc;
+}
+/**
+ * \brief Send a block in one go, the serial layer splits it in USB packets
+ */
+void UsbTask::writeBuffer(const uint8_t *data, int len)
+{
+    CompositeSerial.write(data,len);
+}
+/**
+ * 
+ * @return 
+ */
+int UsbTask::pending()
+{
+    return CompositeSerial.pending();
+}
+/**
+ * \brief What fits in the transmit ring right now, a write that size returns at once
+ */
+int UsbTask::txFree()
+{
+    int n=DSOUSB_TX_BUFFER-1-CompositeSerial.pending();
+    if(n<0) n=0;
+    return n;
+}
 
 // EOF
\ No newline at end of file
@@ -2,6 +2,26 @@
 #include "MapleFreeRTOS1000_pp.h"
 #include "USBComposite.h"
 #include "USBCompositeSerial.h"
+
+/*
+ * Framed protocol (v1), coexists with the legacy 4 bytes commands as those never start with the sync byte
+ *      SYNC VERSION OPCODE LEN payload[LEN] CRC16_LO CRC16_HI
+ * CRC16 is CCITT (poly 0x1021, init 0xffff) over VERSION..payload
+ */
+#define DSOUSB_FRAME_SYNC           0xA5
+#define DSOUSB_FRAME_VERSION        1
+#define DSOUSB_FRAME_HEADER         4
+#define DSOUSB_FRAME_MAX_PAYLOAD    64
+#define DSOUSB_FRAME_MAX            (DSOUSB_FRAME_HEADER+DSOUSB_FRAME_MAX_PAYLOAD+2)
+#define DSOUSB_FRAME_TIMEOUT_MS     100 // a partial frame is dropped after that
+#define DSOUSB_FRAME_NACK           0x7F // opcode of the error reply, payload = 1 byte error code
+/*
+ * SCPI text lines : a line starting with '*' or ':' (never the first byte of a legacy
+ * command nor of a frame) is read up to '\n'. The DSO0 handshake is not needed for them.
+ */
+#define DSOUSB_TEXT_MAX             80  // longer lines are dropped
+#define DSOUSB_TX_BUFFER            256 // USBComposite serial transmit ring, one slot is kept empty
+
 /**
  * 
  */
@@ -13,19 +33,70 @@ public:
         Disconnected=0,
         Connected=1,
         Handshaking=2
+    };
+    enum FrameError
+    {
+        FRAME_ERROR_VERSION=1,
+        FRAME_ERROR_LENGTH=2,
+        FRAME_ERROR_CRC=3,
+        FRAME_ERROR_OPCODE=4,
+        FRAME_ERROR_KEY=5,
+        FRAME_ERROR_BUSY=6     // SET refused, the UI is in a menu / auto setup
     };
                 UsbTask(const char *name,  int priority=2, int taskSize=100): xTask(name,priority,taskSize)
                 {
                     _connected=Disconnected;
+                    _frameIndex=-1;
+                    _textIndex=-1;
+                    _frameBusy=false;
                 }
         void    run();
         void    write32(uint32_t v);
         void    writeFloat(const float f);
+        void    writeBuffer(const uint8_t *data, int len);
+        void    writeFrame(int opcode, int len, const uint8_t *payload);
+        int     pending(); // bytes not yet picked up by the host
+        int     txFree();  // bytes that can be written without blocking
+        bool    isConnected() {return _connected==Connected;}
+        void    lock() {_usbLock.lock();}
+        void    unlock() {_usbLock.unlock();}
         virtual void    processCommand(uint32_t command)=0;
-
+        /**
+         * Called when a bad frame is received, the NACK is not written from the usb task
+         * so that it never ends up in the middle of an outgoing transfer
+         */
+        virtual void    processFrameError(int error)=0;
+        /**
+         * Called when a valid frame has been received, the frame stays in framePayload() and
+         * no other frame is received until frameDone() is called
+         */
+        virtual void    processFrame(int opcode, int len, const uint8_t *payload)=0;
+        const uint8_t  *framePayload() {return _frame+DSOUSB_FRAME_HEADER;}
+        int             frameOpcode() {return _frame[2];}
+        int             frameLength() {return _frame[3];}
+        void            frameDone() {_frameBusy=false;}
+        /**
+         * Same as processFrame for a SCPI line, the line is zero terminated, without the end of line
+         * Call frameDone() when done with it
+         */
+        virtual void    processText(const char *line, int len)=0;
+        const char     *textLine() {return _text;}
+        int             textLength() {return _textLength;}
+        static uint16_t crc16(const uint8_t *data, int len, uint16_t crc=0xffff);
         
 protected:
+        void           frameByte(int c);
+        void           frameError(int error);
+        void           textByte(int c);
+        static bool    isTextStart(int c) {return c=='*' || c==':';}
     
         SerialState    _connected;
+        xMutex         _usbLock;
+        uint8_t        _frame[DSOUSB_FRAME_MAX];
+        int            _frameIndex; // -1 : not receiving a frame
+        char           _text[DSOUSB_TEXT_MAX+1];
+        int            _textIndex; // -1 : not receiving a line, -2 : dropping a line too long
+        int            _textLength;
+        volatile bool  _frameBusy; // a frame or a text line is being processed
         
-};
\ No newline at end of file
+};
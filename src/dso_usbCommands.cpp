@@ -5,8 +5,17 @@
 #include "dso_usbCommands.h"
 #include "dso_capture.h"
 #include "DSO_config.h"
+#include "dso_global.h"
 #include "dso_display.h"
+#include "dso_control.h"
+#include "dso_render.h"
+#include "Adafruit_TFTLCD_8bit_STM32.h"
+#include "dso_scpi.h"
+#include "dso_format.h"
+#include "dso_static.h"
+#include "embedded_printf/printf.h"
 extern DSOCapture                 *capture;
+extern Adafruit_TFTLCD_8bit_STM32 *tft;
 extern DSO_ArmingMode armingMode;
 #define ZDEBUG Logger
 
@@ -29,20 +38,44 @@ public:
              _usbLock.unlock();
         }
         virtual void    processCommand(uint32_t command);    
-        void lock() {_usbLock.lock();}
-        void unlock() {_usbLock.unlock();}
+        virtual void    processFrameError(int error)
+        {
+            _q.post(DSOUSB::ERROR_MARKER+error);
+        }
+        virtual void    processFrame(int opcode, int len, const uint8_t *payload)
+        {
+            _q.post(DSOUSB::FRAME_MARKER); // the frame itself stays in the receive buffer
+        }
+        virtual void    processText(const char *line, int len)
+        {
+            _q.post(DSOUSB::TEXT_MARKER); // same for the text line
+        }
 //protected:
         xQueueEvent _q;
-        xMutex _usbLock;
 };
 extern USBCompositeSerial CompositeSerial;
 UsbCommands *usbTask;
+static DSOStatic<UsbCommands> usbTaskStorage;
+static bool     streaming=false;
+static uint32_t streamSequence=0;
+static uint32_t streamDropped=0;
+static bool     uiBusy=false;  // the UI holds the main loop, see dsoUsb_processBusy
+/**
+ * Window & reduction applied to every capture sent
+ */
+static int      roiStart=0;
+static int      roiLength=0;    // 0 = up to the end
+static int      decimation=1;
+static int      reduction=DSOUSB::REDUCE_STRIDE;
 void uiSetVoltage(int v);
 void uiSetTimeBase(int v);
 void uiSetTriggerMode(int v);
 void uiSetArmingMode(int v);
 void uiRequestCapture(bool );
 void uiSetTriggerValue(int v);
+void uiSetTriggerVoltage(float v);
+void uiSetVoltageOffset(float v);
+int  uiLastCapture(float **samples, CaptureStats **stats);
 /**
  * 
  */
@@ -59,7 +92,7 @@ void dso_usbInit()
   USBComposite.setManufacturerString("DSO150DUINO");
   USBComposite.setSerialString("01234");        
   CompositeSerial.begin(115200);      
-  usbTask=new UsbCommands("UsbControl",2,200);
+  usbTask=usbTaskStorage.create("UsbControl",2,DSO_USB_TASK_STACK);
 }
 
 /*
@@ -94,24 +127,87 @@ void UsbCommands::processCommand(uint32_t command)
     if(!valid)
     {
         ZDEBUG("Invalid command received\n");
-        write32((DSOUSB::NACK<<24));
+        _q.post(DSOUSB::NACK_MARKER);
     }else
     {
         _q.post(command);
     }
     
 }
+static void processOneCommand(uint32_t cmd);
+static bool setReduction(int target, int value);
+static bool validSetting(int target, int value);
+static void processFrameCommand();
+static void sendScreenshot();
+static void processTextCommand();
+static bool pumpTransfer();
+static void screenshotStep();
 /**
- * 
- * @param cmd
- * @return 
+ * \fn dsoUsb_processNextCommand
+ * \brief Called once per main loop iteration, that is not a fixed rate :
+ *   - up to ~30 ms when no capture comes (the capture semaphore timeout)
+ *   - up to 150 ms more while the rotary is turned (readRotary burst)
+ * Meanwhile the commands queue in the usb task (10 deep) and are applied once back here
+ * Everything that is queued is applied, so a burst of commands costs one iteration
+ * While a menu, the calibration or the auto setup holds the loop, dsoUsb_processBusy
+ * takes over
+ * While a transfer is still going out, the commands wait so that their replies
+ * are not interleaved with it
  */
 void dsoUsb_processNextCommand()
 {
     if(!usbTask) return  ;
-    if(usbTask->_q.empty()) return  ;
+    if(!pumpTransfer()) return;
     uint32_t cmd;
-    usbTask->_q.get(0,cmd);
+    while(!usbTask->_q.empty())
+    {
+        usbTask->_q.get(0,cmd);
+        processOneCommand(cmd);
+        if(!pumpTransfer()) // a transfer was staged, the next replies must go after it
+            return;
+    }
+}
+/**
+ * \fn dsoUsb_processBusy
+ * \brief Called every few ms by the loops that hold the main loop (menus, calibration,
+ * auto setup) : reads and screenshots are served, settings are refused at once with a
+ * busy error (NACK, FRAME_ERROR_BUSY, SCPI -221) so the host can tell busy from hung
+ */
+void dsoUsb_processBusy()
+{
+    uiBusy=true;
+    dsoUsb_processNextCommand();
+    uiBusy=false;
+}
+/**
+ * 
+ * @param cmd
+ */
+static void processOneCommand(uint32_t cmd)
+{
+    if(cmd==DSOUSB::NACK_MARKER)
+    {
+        usbTask->write32((DSOUSB::NACK<<24));
+        return;
+    }
+    if((cmd&0xff000000)==DSOUSB::ERROR_MARKER)
+    {
+        uint8_t e=cmd&0xff;
+        usbTask->lock();
+        usbTask->writeFrame(DSOUSB_FRAME_NACK,1,&e);
+        usbTask->unlock();
+        return;
+    }
+    if(cmd==DSOUSB::FRAME_MARKER)
+    {
+        processFrameCommand();
+        return;
+    }
+    if(cmd==DSOUSB::TEXT_MARKER)
+    {
+        processTextCommand();
+        return;
+    }
     
     int type=cmd>>24;
     int target=(cmd>>16)&0Xff;
@@ -128,6 +224,11 @@ void dsoUsb_processNextCommand()
                 case DSOUSB::TRIGGER:     usbTask->replyOk( (int) DSOCapture::getTriggerMode());return;                
                 case DSOUSB::ARMINGMODE:  usbTask->replyOk(armingMode );return;       
                 case DSOUSB::TRIGGERVALUE: usbTask->replyOk(capture->getTriggerValue()*100.+32768 );return;    
+                case DSOUSB::STREAM:      usbTask->replyOk(streaming);return;
+                case DSOUSB::ROI_START:   usbTask->replyOk(roiStart);return;
+                case DSOUSB::ROI_LENGTH:  usbTask->replyOk(roiLength);return;
+                case DSOUSB::DECIMATION:  usbTask->replyOk(decimation);return;
+                case DSOUSB::REDUCTION:   usbTask->replyOk(reduction);return;
                 case DSOUSB::DATA:                
                 default:
                      usbTask->write32((DSOUSB::NACK<<24));
@@ -136,6 +237,11 @@ void dsoUsb_processNextCommand()
             return;
             break;
         case DSOUSB::SET:
+            if((uiBusy && target!=DSOUSB::SCREENSHOT) || !validSetting(target,value))
+            {
+                usbTask->write32((DSOUSB::NACK<<24));
+                return;
+            }
             switch(target)
             {           
 
@@ -145,6 +251,22 @@ void dsoUsb_processNextCommand()
                 case DSOUSB::ARMINGMODE:  uiSetArmingMode(value);usbTask->replyOk(0);return;               
                 case DSOUSB::DATA:        usbTask->replyOk(0);uiRequestCapture(value);return;   
                 case DSOUSB::TRIGGERVALUE:uiSetTriggerValue(value); usbTask->replyOk(0);return;
+                case DSOUSB::SCREENSHOT:  usbTask->replyOk(0);sendScreenshot();return;
+                case DSOUSB::STREAM:      
+                    streaming=!!value;
+                    streamSequence=0;
+                    streamDropped=0;
+                    usbTask->replyOk(0);
+                    return;
+                case DSOUSB::ROI_START:
+                case DSOUSB::ROI_LENGTH:
+                case DSOUSB::DECIMATION:
+                case DSOUSB::REDUCTION:
+                    if(setReduction(target,value))
+                        usbTask->replyOk(0);
+                    else
+                        usbTask->write32((DSOUSB::NACK<<24));
+                    return;
                 default:
                     usbTask->write32((DSOUSB::NACK<<24));
                     break;
@@ -157,16 +279,704 @@ void dsoUsb_processNextCommand()
     }
     return ;
 }
-void dsoUsb_sendData(int count,float *data, CaptureStats &stats)
+/*
+ * Framed protocol, see dso_usb.h for the framing and dso_usbCommands.h for the keys
+ */
+typedef struct 
 {
-    usbTask->lock();
-    usbTask->write32(    (DSOUSB::EVENT<<24)+(DSOUSB::DATA<<16)+count);
-    for(int i=0;i<count;i++)
+    uint8_t key;
+    uint8_t type;   // DSOUSB_KeyType
+    uint8_t access; // DSOUSB_KeyAccess
+}KeyDescriptor;
+
+static const KeyDescriptor keyTable[]=
+{
+    {DSOUSB::VOLTAGE,       DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::TIMEBASE,      DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::TRIGGER,       DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::ARMINGMODE,    DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::TRIGGERVALUE,  DSOUSB::KEY_FLOAT,  DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::OFFSET,        DSOUSB::KEY_FLOAT,  DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::STREAM,        DSOUSB::KEY_INT,    DSOUSB::KEY_READ},
+    {DSOUSB::FIRMWARE,      DSOUSB::KEY_INT,    DSOUSB::KEY_READ},
+    {DSOUSB::ROI_START,     DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::ROI_LENGTH,    DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::DECIMATION,    DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+    {DSOUSB::REDUCTION,     DSOUSB::KEY_INT,    DSOUSB::KEY_READ|DSOUSB::KEY_WRITE},
+};
+#define NB_KEYS ((int)(sizeof(keyTable)/sizeof(KeyDescriptor)))
+// GET with no key replies with all of them, CAPS with all the descriptors
+static_assert(5*NB_KEYS<=DSOUSB_FRAME_MAX_PAYLOAD,"GET reply does not fit in a frame");
+static_assert(5+3*NB_KEYS<=DSOUSB_FRAME_MAX_PAYLOAD,"CAPS reply does not fit in a frame");
+#define USB_MAX_VOLT 100. // trigger & offset beyond that are rejected, the input range is much smaller
+
+/**
+ * 
+ * @param key
+ * @return NULL if unknown
+ */
+static const KeyDescriptor *lookupKey(int key)
+{
+    for(int i=0;i<NB_KEYS;i++)
+        if(keyTable[i].key==key)
+            return keyTable+i;
+    return NULL;
+}
+/**
+ * \brief Read a key, 4 bytes little endian, int32 or float depending on the key type
+ */
+static void getKey(int key, uint8_t *out)
+{
+    int   i=0;
+    float f=0;
+    switch(key)
+    {
+        case DSOUSB::VOLTAGE:       i=capture->getVoltageRange();break;
+        case DSOUSB::TIMEBASE:      i=capture->getTimeBase();break;
+        case DSOUSB::TRIGGER:       i=(int)DSOCapture::getTriggerMode();break;
+        case DSOUSB::ARMINGMODE:    i=armingMode;break;
+        case DSOUSB::STREAM:        i=streaming;break;
+        case DSOUSB::FIRMWARE:      i=(DSO_VERSION_MAJOR<<8)+(DSO_VERSION_MINOR);break;
+        case DSOUSB::ROI_START:     i=roiStart;break;
+        case DSOUSB::ROI_LENGTH:    i=roiLength;break;
+        case DSOUSB::DECIMATION:    i=decimation;break;
+        case DSOUSB::REDUCTION:     i=reduction;break;
+        case DSOUSB::TRIGGERVALUE:  f=capture->getTriggerValue();break;
+        case DSOUSB::OFFSET:        f=capture->getVoltageOffset();break;
+        default:                    xAssert(0);break;
+    }
+    if(lookupKey(key)->type==DSOUSB::KEY_FLOAT)
+        memcpy(out,&f,4);
+    else
+        memcpy(out,&i,4);
+}
+/**
+ * \brief Range check of the int settings, nothing invalid must reach the ui/capture layer
+ * @return false if the value is out of its enum
+ */
+static bool validSetting(int target, int value)
+{
+    switch(target)
     {
-        usbTask->writeFloat(  data[i]);
+        case DSOUSB::VOLTAGE:    return value>=0 && value<=DSOCapture::DSO_VOLTAGE_MAX;
+        case DSOUSB::TIMEBASE:   return value>=0 && value<=DSOCapture::DSO_TIME_BASE_MAX;
+        case DSOUSB::TRIGGER:    return value>=0 && value<=DSOCapture::Trigger_Run;
+        case DSOUSB::ARMINGMODE: return value>=0 && value<=DSO_CAPTURE_CONTINUOUS;
+        default:                 return true;
     }
+}
+/**
+ * \brief Returns false if the key is not writable or the value is out of range
+ * NaN fails both comparisons so it is rejected along with inf & huge values
+ */
+static bool setKey(int key, const uint8_t *in)
+{
+    int   i;
+    float f;
+    memcpy(&i,in,4);
+    memcpy(&f,in,4);
+    if(lookupKey(key)->type==DSOUSB::KEY_FLOAT)
+    {
+        if(!(f>=-USB_MAX_VOLT && f<=USB_MAX_VOLT))
+            return false;
+    }else if(!validSetting(key,i))
+        return false;
+    switch(key)
+    {
+        case DSOUSB::VOLTAGE:       uiSetVoltage(i);break;
+        case DSOUSB::TIMEBASE:      uiSetTimeBase(i);break;
+        case DSOUSB::TRIGGER:       uiSetTriggerMode(i);break;
+        case DSOUSB::ARMINGMODE:    uiSetArmingMode(i);break;
+        case DSOUSB::TRIGGERVALUE:  uiSetTriggerVoltage(f);break;
+        case DSOUSB::OFFSET:        uiSetVoltageOffset(f);break;
+        case DSOUSB::ROI_START:
+        case DSOUSB::ROI_LENGTH:
+        case DSOUSB::DECIMATION:
+        case DSOUSB::REDUCTION:     return setReduction(key,i);
+        default:                    xAssert(0);break;
+    }
+    return true;
+}
+/**
+ * \fn processFrameCommand
+ * \brief Execute the frame waiting in the usb task receive buffer, then release it
+ * Requests :
+ *      CAPS : no payload, reply = version, fw major, fw minor, max payload, nb keys, nb keys*(key,type,access)
+ *      GET  : list of keys, empty = all readable keys, reply = list of (key, 4 bytes value)
+ *      SET  : list of (key, 4 bytes value), reply = list of (key, status)
+ * Replies use the request opcode | DSOUSB::OP_REPLY
+ */
+static void processFrameCommand()
+{
+    const uint8_t *in=usbTask->framePayload();
+    int opcode=usbTask->frameOpcode();
+    int len=usbTask->frameLength();
+    uint8_t out[DSOUSB_FRAME_MAX_PAYLOAD];
+    int outLen=0;
+    int error=0;
     
+    switch(opcode)
+    {
+        case DSOUSB::OP_CAPS:
+        {
+            out[outLen++]=DSOUSB_FRAME_VERSION;
+            out[outLen++]=DSO_VERSION_MAJOR;
+            out[outLen++]=DSO_VERSION_MINOR;
+            out[outLen++]=DSOUSB_FRAME_MAX_PAYLOAD;
+            out[outLen++]=NB_KEYS;
+            for(int i=0;i<NB_KEYS;i++)
+            {
+                out[outLen++]=keyTable[i].key;
+                out[outLen++]=keyTable[i].type;
+                out[outLen++]=keyTable[i].access;
+            }
+            break;
+        }
+        case DSOUSB::OP_GET:
+        {
+            if(!len) // everything
+            {
+                for(int i=0;i<NB_KEYS;i++)
+                {
+                    out[outLen]=keyTable[i].key;
+                    getKey(keyTable[i].key,out+outLen+1);
+                    outLen+=5;
+                }
+                break;
+            }
+            if(len*5>DSOUSB_FRAME_MAX_PAYLOAD)
+            {
+                error=UsbTask::FRAME_ERROR_LENGTH;
+                break;
+            }
+            for(int i=0;i<len && !error;i++)
+            {
+                const KeyDescriptor *k=lookupKey(in[i]);
+                if(!k || !(k->access & DSOUSB::KEY_READ))
+                {
+                    error=UsbTask::FRAME_ERROR_KEY;
+                    break;
+                }
+                out[outLen]=k->key;
+                getKey(k->key,out+outLen+1);
+                outLen+=5;
+            }
+            break;
+        }
+        case DSOUSB::OP_SET:
+        {
+            if(uiBusy)
+            {
+                error=UsbTask::FRAME_ERROR_BUSY;
+                break;
+            }
+            if(len%5)
+            {
+                error=UsbTask::FRAME_ERROR_LENGTH;
+                break;
+            }
+            for(int i=0;i<len;i+=5)
+            {
+                const KeyDescriptor *k=lookupKey(in[i]);
+                int status=DSOUSB::SET_OK;
+                if(!k)
+                    status=DSOUSB::SET_UNKNOWN_KEY;
+                else if(!(k->access & DSOUSB::KEY_WRITE))
+                    status=DSOUSB::SET_READ_ONLY;
+                else if(!setKey(k->key,in+i+1))
+                    status=DSOUSB::SET_BAD_VALUE;
+                out[outLen++]=in[i];
+                out[outLen++]=status;
+            }
+            break;
+        }
+        default:
+            error=UsbTask::FRAME_ERROR_OPCODE;
+            break;
+    }
+    usbTask->lock();
+    if(error)
+    {
+        uint8_t e=error;
+        usbTask->writeFrame(DSOUSB_FRAME_NACK,1,&e);
+    }
+    else
+        usbTask->writeFrame(opcode|DSOUSB::OP_REPLY,outLen,out);
     usbTask->unlock();
+    usbTask->frameDone();
+}
+/**
+ * 
+ * @param target
+ * @param value
+ * @return false if the value is invalid
+ */
+static bool setReduction(int target, int value)
+{
+    if(value<0) return false;
+    switch(target)
+    {
+        case DSOUSB::ROI_START:  roiStart=value;break;
+        case DSOUSB::ROI_LENGTH: roiLength=value;break;
+        case DSOUSB::DECIMATION: 
+            if(value<1 || value>255) return false;
+            decimation=value;
+            break;
+        case DSOUSB::REDUCTION:  
+            if(value>DSOUSB::REDUCE_MINMAX) return false;
+            reduction=value;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+/**
+ * \brief Clip the window to the capture
+ * @return number of codes that will be sent
+ */
+static int window(int count, int &start, int &length)
+{
+    start=roiStart;
+    if(start>count) start=count;
+    length=count-start;
+    if(roiLength && roiLength<length) 
+        length=roiLength;
+    int buckets=(length+decimation-1)/decimation; // the last one can be partial
+    if(reduction==DSOUSB::REDUCE_MINMAX)
+        return buckets*2;
+    return buckets;
+}
+/**
+ * \brief volt to ADC code, rounded
+ */
+static inline uint16_t toCode(float v, float invScale, int offset)
+{
+    float f=v*invScale;
+    int code=offset+(int)(f<0 ? f-0.5 : f+0.5);
+    if(code<0) code=0;
+    if(code>0xffff) code=0xffff;
+    return code;
+}
+/*
+ * Outgoing transfer : a frame too large for the USB transmit ring is built here,
+ * then pushed a bit at each main loop iteration, never more than what fits
+ * so the main loop does not wait for the host
+ */
+#define USB_TX_STAGING (4+sizeof(DSOUSB::DSOUSB_StreamHeader)+sizeof(DSOUSB::DSOUSB_DataHeader)+2*2*DSO_WAVEFORM_WIDTH)
+static uint8_t  txStaging[USB_TX_STAGING];
+static int      txLength=0;
+static int      txSent=0;
+static int      screenRow=-1; // next screenshot row to encode, -1 : no screenshot going on
+#define USB_SCREEN_ROWS 4     // rows encoded per pumpTransfer call at most, ~ 2 ms each
+
+/**
+ * \brief Append to the outgoing transfer
+ */
+static void stagedWrite(const uint8_t *data, int len)
+{
+    xAssert(txLength+len<=(int)USB_TX_STAGING);
+    memcpy(txStaging+txLength,data,len);
+    txLength+=len;
+}
+static void stagedWrite32(uint32_t v)
+{
+    uint8_t c[4]={(uint8_t)(v>>24),(uint8_t)(v>>16),(uint8_t)(v>>8),(uint8_t)v};
+    stagedWrite(c,4);
+}
+// Worst case for a 320 pixels row : 2 bytes per pixel (alternating marker / literal) + block lengths
+static_assert(2*320+2*320/(DSO_RLE_BLOCK-2)+2<=USB_TX_STAGING,"a screenshot row does not fit in the staging buffer");
+static DSORleEncoder screenRle(stagedWrite);
+/**
+ * \fn pumpTransfer
+ * \brief Push what fits of the outgoing transfer in the USB transmit ring
+ * A screenshot is refilled row by row as it goes out, USB_SCREEN_ROWS at most per call
+ * The transfer is dropped if the host goes away
+ * @return true if there is nothing left to send
+ */
+static bool pumpTransfer()
+{
+    if(txSent>=txLength && screenRow<0)
+        return true;
+    if(!usbTask->isConnected())
+    {
+        txSent=txLength=0;
+        screenRow=-1;
+        return true;
+    }
+    int rows=0;
+    while(1)
+    {
+        int n=txLength-txSent;
+        int room=usbTask->txFree();
+        if(n>room) n=room;
+        if(n)
+        {
+            usbTask->lock();
+            usbTask->writeBuffer(txStaging+txSent,n);
+            usbTask->unlock();
+            txSent+=n;
+        }
+        if(txSent<txLength)
+            return false;
+        txSent=txLength=0;
+        if(screenRow<0)
+            return true;
+        if(rows++>=USB_SCREEN_ROWS)
+            return false;
+        screenshotStep();
+    }
+}
+/**
+ * \fn sendCodes
+ * \brief Stage a capture as ADC codes, see DSOUSB_DataHeader
+ * The samples are in volt, they are converted back to codes with the scale & offset
+ * recorded when they were captured, so that the host gets volt=(code-offset)*scale
+ * within half a code (1/32 LSB when the linearity correction is on)
+ * Only the window is sent, each bucket of decimation samples is reduced to one code (2 for min/max)
+ * The codes are sent by chunks of USB_DATA_CHUNK codes, i.e. a few large writes
+ */
+#define USB_DATA_CHUNK 64
+static void sendCodes(int count,float *data, CaptureStats &stats)
+{
+    int start,length;
+    window(count,start,length);
     
+    DSOUSB::DSOUSB_DataHeader header;
+    header.sequence=stats.sequence;
+    header.timestamp=stats.timestamp;
+    header.sampleInterval=stats.sampleInterval;
+    header.trigger=-1; // in Run mode stats.trigger is only the middle of the screen
+    header.flags=0;
+    if(stats.saturation)
+        header.flags|=DSOUSB::CAPTURE_SATURATED;
+    if(stats.triggered && stats.trigger>=0)
+    {
+        header.trigger=stats.trigger;
+        header.flags|=DSOUSB::CAPTURE_TRIGGERED;
+    }
+    header.timeBase=stats.timeBase;
+    header.voltage=stats.voltageRange;
+    header.reserved=0;
+    header.scale=stats.codeScale;
+    header.offset=(uint16_t)(stats.codeOffset+0.5);
+    header.bitsPerSample=stats.codeBits;
+    header.start=start;
+    header.stride=decimation;
+    header.reduction=reduction;
+    float invScale=0;
+    if(header.scale!=0.) 
+        invScale=1./header.scale;
+    
+    uint16_t codes[USB_DATA_CHUNK];
+    int n=0;
+    stagedWrite((uint8_t *)&header,sizeof(header));
+    float *p=data+start;
+    float *end=p+length;
+    while(p<end)
+    {
+        int bucket=end-p;
+        if(bucket>decimation) bucket=decimation;
+        switch(reduction)
+        {
+            case DSOUSB::REDUCE_STRIDE:
+                codes[n++]=toCode(p[0],invScale,header.offset);
+                break;
+            case DSOUSB::REDUCE_AVERAGE:
+            {
+                float sum=0;
+                for(int i=0;i<bucket;i++) 
+                    sum+=p[i];
+                codes[n++]=toCode(sum/(float)bucket,invScale,header.offset);
+                break;
+            }
+            case DSOUSB::REDUCE_MINMAX:
+            {
+                float mn=p[0],mx=p[0];
+                for(int i=1;i<bucket;i++) 
+                {
+                    if(p[i]<mn) mn=p[i];
+                    if(p[i]>mx) mx=p[i];
+                }
+                codes[n++]=toCode(mn,invScale,header.offset);
+                codes[n++]=toCode(mx,invScale,header.offset);
+                break;
+            }
+            default:
+                xAssert(0);
+                break;
+        }
+        p+=bucket;
+        if(n>=USB_DATA_CHUNK-1) // leave room for min/max
+        {
+            stagedWrite((uint8_t *)codes,n*2);
+            n=0;
+        }
+    }
+    if(n)
+        stagedWrite((uint8_t *)codes,n*2);
+}
+/**
+ * \fn dsoUsb_sendData
+ * \brief Reply to SET DATA, staged like the stream so the main loop never waits for the host
+ * @return false if another transfer is still going out, the caller retries with a later capture
+ */
+bool dsoUsb_sendData(int count,float *data, CaptureStats &stats)
+{
+    if(!usbTask) return true;
+    if(!pumpTransfer())
+        return false;
+    int start,length;
+    stagedWrite32(    (DSOUSB::EVENT<<24)+(DSOUSB::DATA<<16)+window(count,start,length));
+    sendCodes(count,data,stats);
+    pumpTransfer();
+    return true;
+}
+/**
+ * \fn dsoUsb_streamData
+ * \brief Called for every capture, pushes it to the host if streaming is on
+ * Flow control : the frame is staged and only what fits in the USB buffer is written,
+ * the rest goes out at the next iterations. If the previous frame is still going out
+ * the host is not keeping up and this capture is dropped, and counted as such
+ * @return true if the frame was queued
+ */
+bool dsoUsb_streamData(int count,float *data, CaptureStats &stats)
+{
+    if(!streaming || !usbTask) return false;
+    streamSequence++;
+    if(!usbTask->isConnected())
+    {
+        streaming=false;
+        return false;
+    }
+    if(!pumpTransfer())
+    {
+        streamDropped++;
+        return false;
+    }
+    DSOUSB::DSOUSB_StreamHeader header;
+    header.sequence=streamSequence;
+    header.dropped=streamDropped;
+    int start,length;
+    stagedWrite32(    (DSOUSB::EVENT<<24)+(DSOUSB::STREAM<<16)+window(count,start,length));
+    stagedWrite((uint8_t *)&header,sizeof(header));
+    sendCodes(count,data,stats);
+    pumpTransfer();
+    return true;
+}
+/**
+ * \fn sendScreenshot
+ * \brief Start sending the screen, read back from the LCD as RLE RGB332
+ * The rows are read and encoded one at a time by screenshotStep as the
+ * transfer goes out, see pumpTransfer
+ */
+static void sendScreenshot()
+{
+    DSOUSB::DSOUSB_ScreenHeader header;
+    header.width=tft->width();
+    header.height=tft->height();
+    header.format=DSOUSB::PIXEL_RGB332;
+    header.marker=DSOUSB_RLE_MARKER;
+    stagedWrite32(    (DSOUSB::EVENT<<24)+(DSOUSB::SCREENSHOT<<16)+header.height);
+    stagedWrite((uint8_t *)&header,sizeof(header));
+    screenRow=0;
+}
+/**
+ * \fn screenshotStep
+ * \brief Read & encode the next row of the screenshot in the staging buffer
+ * The row is read by small chunks between DSORender::lock/unlock so the
+ * render task and the buttons are not held off for long
+ */
+#define USB_SCREEN_CHUNK 64
+static void screenshotStep()
+{
+    uint8_t pixels[USB_SCREEN_CHUNK];
+    int width=tft->width();
+    for(int x=0;x<width;x+=USB_SCREEN_CHUNK)
+    {
+        int n=width-x;
+        if(n>USB_SCREEN_CHUNK) n=USB_SCREEN_CHUNK;
+        DSORender::lock();
+        tft->readPixels332(x,screenRow,n,pixels);
+        DSORender::unlock();
+        for(int i=0;i<n;i++)
+            screenRle.add(pixels[i]);
+    }
+    screenRle.endLine();
+    screenRle.flushBlock();
+    screenRow++;
+    if(screenRow>=tft->height())
+    {
+        screenRle.end();
+        screenRow=-1;
+    }
+}
+/*
+ * SCPI front end, see dso_scpi.h for the syntax
+ * The replies are terminated by '\n', the errors go in a one entry error queue
+ * read by :SYSTem:ERRor?
+ * The replies of a line are staged and go out after it, in order, see pumpTransfer
+ */
+static int scpiLastError=DSOScpi::ERR_NONE;
+static const float scpiTimeBases[DSOCapture::DSO_TIME_BASE_MAX+1]= // s/div, same order as DSO_TIME_BASE
+{
+    5e-6,10e-6,25e-6,50e-6,100e-6,200e-6,500e-6,
+    1e-3,2e-3,5e-3,10e-3,20e-3,50e-3,100e-3,200e-3,500e-3,
+    1.
+};
+/**
+ * \brief Stage a text reply
+ * @return ERR_TOO_MUCH_DATA if the replies of the line do not fit
+ */
+static int scpiReply(const char *text)
+{
+    int len=strlen(text);
+    if(txLength+len+1>(int)USB_TX_STAGING)
+        return DSOScpi::ERR_TOO_MUCH_DATA;
+    stagedWrite((const uint8_t *)text,len);
+    stagedWrite((const uint8_t *)"\n",1);
+    return DSOScpi::ERR_NONE;
+}
+static int scpiReplyFloat(float f)
+{
+    char buffer[DSO_FORMAT_BUFFER_SIZE];
+    return scpiReply(DSOFormat::scientific(f,buffer));
+}
+/**
+ * \brief Get the numeric argument of a command
+ */
+static int scpiArgument(const DSOScpi::Token &arg, float &f)
+{
+    if(!arg.len)
+        return DSOScpi::ERR_MISSING_PARAMETER;
+    if(!DSOScpi::toFloat(arg,f))
+        return DSOScpi::ERR_DATA_TYPE;
+    return DSOScpi::ERR_NONE;
+}
+static int scpiIdn(bool query, const DSOScpi::Token &arg)
+{
+    if(!query) return DSOScpi::ERR_QUERY;
+    char buffer[40];
+    sprintf(buffer,"DSO150DUINO,DSO150,0,%d.%d",DSO_VERSION_MAJOR,DSO_VERSION_MINOR);
+    return scpiReply(buffer);
+}
+static int scpiError(bool query, const DSOScpi::Token &arg)
+{
+    if(!query) return DSOScpi::ERR_QUERY;
+    char buffer[40];
+    sprintf(buffer,"%d,\"%s\"",scpiLastError,DSOScpi::errorText(scpiLastError));
+    int er=scpiReply(buffer);
+    if(er==DSOScpi::ERR_NONE)
+        scpiLastError=DSOScpi::ERR_NONE;
+    return er;
+}
+/**
+ * Time base : the smallest one that is at least what was asked
+ */
+static int scpiTimeScale(bool query, const DSOScpi::Token &arg)
+{
+    if(query)
+    {
+        return scpiReplyFloat(scpiTimeBases[capture->getTimeBase()]);
+    }
+    float f;
+    int er=scpiArgument(arg,f);
+    if(er) return er;
+    if(f<=0)
+        return DSOScpi::ERR_DATA_OUT_OF_RANGE;
+    int t=DSOCapture::DSO_TIME_BASE_MAX;
+    for(int i=DSOCapture::DSO_TIME_BASE_MAX;i>=0;i--)
+        if(scpiTimeBases[i]>=f*0.999f)
+            t=i;
+    uiSetTimeBase(t);
+    return DSOScpi::ERR_NONE;
+}
+/**
+ * Volt / div : the smallest range that is at least what was asked, GND cannot be selected
+ */
+static int scpiChannelScale(bool query, const DSOScpi::Token &arg)
+{
+    if(query)
+    {
+        float v=0;
+        if(capture->getVoltageRange()!=DSOCapture::DSO_VOLTAGE_GND)
+            v=DSOCapture::getVoltageRangeAsFloat(capture->getVoltageRange());
+        return scpiReplyFloat(v);
+    }
+    float f;
+    int er=scpiArgument(arg,f);
+    if(er) return er;
+    if(f<=0)
+        return DSOScpi::ERR_DATA_OUT_OF_RANGE;
+    int r=DSOCapture::DSO_VOLTAGE_MAX;
+    for(int i=DSOCapture::DSO_VOLTAGE_MAX;i>DSOCapture::DSO_VOLTAGE_GND;i--)
+        if(DSOCapture::getVoltageRangeAsFloat((DSOCapture::DSO_VOLTAGE_RANGE)i)>=f*0.999f)
+            r=i;
+    uiSetVoltage(r);
+    return DSOScpi::ERR_NONE;
+}
+static int scpiTriggerLevel(bool query, const DSOScpi::Token &arg)
+{
+    if(query)
+    {
+        return scpiReplyFloat(capture->getTriggerValue());
+    }
+    float f;
+    int er=scpiArgument(arg,f);
+    if(er) return er;
+    if(!(f>=-USB_MAX_VOLT && f<=USB_MAX_VOLT)) // same as the framed SET, also rejects NaN
+        return DSOScpi::ERR_DATA_OUT_OF_RANGE;
+    uiSetTriggerVoltage(f);
+    return DSOScpi::ERR_NONE;
+}
+// #<up to 4 digits><length> the biggest capture \n, alone on its line it must fit
+static_assert(6+sizeof(DSOUSB::DSOUSB_DataHeader)+2*2*DSO_WAVEFORM_WIDTH+1<=USB_TX_STAGING,"a waveform block does not fit in the staging buffer");
+/**
+ * Last capture as an IEEE 488.2 definite length block : #<n digits><length><data>\n
+ * data is the same as after the EVENT/DATA word : DSOUSB_DataHeader then the codes,
+ * window and reduction apply
+ */
+static int scpiWaveformData(bool query, const DSOScpi::Token &arg)
+{
+    if(!query) return DSOScpi::ERR_QUERY;
+    float *data;
+    CaptureStats *stats;
+    int count=uiLastCapture(&data,&stats);
+    int start,length;
+    int bytes=sizeof(DSOUSB::DSOUSB_DataHeader)+2*window(count,start,length);
+    char digits[12],head[16];
+    sprintf(digits,"%d",bytes);
+    sprintf(head,"#%d%s",(int)strlen(digits),digits);
+    int headLen=strlen(head);
+    if(txLength+headLen+bytes+1>(int)USB_TX_STAGING)
+        return DSOScpi::ERR_TOO_MUCH_DATA;
+    stagedWrite((const uint8_t *)head,headLen);
+    sendCodes(count,data,*stats);
+    stagedWrite((const uint8_t *)"\n",1);
+    return DSOScpi::ERR_NONE;
+}
+
+static const DSOScpi::Command scpiTable[]=
+{
+    {"*IDN",                scpiIdn},
+    {":SYSTem:ERRor",       scpiError},
+    {":TIMebase:SCALe",     scpiTimeScale},
+    {":CHANnel:SCALe",      scpiChannelScale},
+    {":TRIGger:LEVel",      scpiTriggerLevel},
+    {":WAVeform:DATA",      scpiWaveformData},
+};
+/**
+ * \fn processTextCommand
+ * \brief Execute the SCPI line waiting in the usb task buffer, then release it
+ */
+static void processTextCommand()
+{
+    int er=DSOScpi::execute(usbTask->textLine(),usbTask->textLength(),scpiTable,sizeof(scpiTable)/sizeof(DSOScpi::Command),uiBusy);
+    if(er!=DSOScpi::ERR_NONE)
+    {
+        ZDEBUG("SCPI error %d on <%s>\n",er,usbTask->textLine());
+        scpiLastError=er;
+    }
+    usbTask->frameDone();
 }
 // EOF
@@ -1,4 +1,6 @@
 #pragma once
+#include "dso_usb.h"
+#include "dso_rle.h"
 namespace DSOUSB
 {
 enum DSOUSB_Command
@@ -18,10 +20,123 @@ enum DSOUSB_Target
     ARMINGMODE=4,
     DATA=5,
     TRIGGERVALUE=6,
+    STREAM=7,
+    OFFSET=8,       // framed protocol only
     FIRMWARE=10,
+    ROI_START=11,   // first sample sent
+    ROI_LENGTH=12,  // number of samples in the window, 0 = up to the end
+    DECIMATION=13,  // samples per bucket, 1 = no reduction
+    REDUCTION=14,   // DSOUSB_Reduction
+    SCREENSHOT=15,  // SET only, replies with a screenshot event
     TARGET_LAST
 };
 
+/**
+ * Framed protocol opcodes, the reply has OP_REPLY set
+ */
+enum DSOUSB_Opcode
+{
+    OP_CAPS=1,
+    OP_GET=2,
+    OP_SET=3,
+    OP_REPLY=0x80
+};
+enum DSOUSB_KeyType
+{
+    KEY_INT=0,      // int32
+    KEY_FLOAT=1     // float32, in volt
+};
+enum DSOUSB_KeyAccess
+{
+    KEY_READ=1,
+    KEY_WRITE=2
+};
+enum DSOUSB_SetStatus
+{
+    SET_OK=0,
+    SET_UNKNOWN_KEY=1,
+    SET_READ_ONLY=2,
+    SET_BAD_VALUE=3
+};
+// Posted in the command queue in place of a legacy command when a frame is ready
+const uint32_t FRAME_MARKER=((uint32_t)DSOUSB_FRAME_SYNC)<<24;
+// Same for a SCPI text line
+const uint32_t TEXT_MARKER=((uint32_t)'*')<<24;
+// NACK of an invalid legacy command, posted by the usb task
+const uint32_t NACK_MARKER=((uint32_t)0xFF)<<24;
+// NACK frame of a bad frame, the error code is in the low byte
+const uint32_t ERROR_MARKER=((uint32_t)DSOUSB_FRAME_NACK)<<24;
+
+/**
+ * How each bucket of DECIMATION samples is reduced
+ */
+enum DSOUSB_Reduction
+{
+    REDUCE_STRIDE=0,    // first sample of the bucket
+    REDUCE_AVERAGE=1,   // average of the bucket
+    REDUCE_MINMAX=2     // min then max of the bucket, 2 codes per bucket
+};
+enum DSOUSB_CaptureFlags
+{
+    CAPTURE_SATURATED=1,    // some samples hit the ADC rails
+    CAPTURE_TRIGGERED=2     // trigger is valid
+};
+/**
+ * Sent after the EVENT/DATA word, followed by count little endian uint16 codes
+ * volt=(code-offset)*scale, within half a code
+ * bitsPerSample is 12 for plain ADC codes, 16 when the linearity correction is on (codes in 1/16 LSB)
+ * All the fields describe the capture as it was taken, not the current settings
+ * Code i covers the samples start+(i*stride) ... (i/2 for min/max)
+ * Sample n of the full capture is at (n-trigger)*sampleInterval from the trigger
+ */
+typedef struct 
+{
+    float       scale;          // volt per ADC code
+    uint16_t    offset;         // ADC code for 0 volt
+    uint16_t    bitsPerSample;  // significant bits in each code
+    uint16_t    start;          // index of the first sample of the window
+    uint8_t     stride;         // samples per bucket
+    uint8_t     reduction;      // DSOUSB_Reduction
+    uint32_t    sequence;       // capture number since boot
+    uint32_t    timestamp;      // ms since boot
+    float       sampleInterval; // s between two samples of the full capture
+    int16_t     trigger;        // index of the trigger in the full capture, -1 = none
+    uint16_t    flags;          // DSOUSB_CaptureFlags
+    uint8_t     timeBase;       // DSOUSB_TIMEBASE
+    uint8_t     voltage;        // DSOUSB_VOLTAGE
+    uint16_t    reserved;
+}DSOUSB_DataHeader;
+
+/**
+ * Streaming : sent after the EVENT/STREAM word, followed by a DSOUSB_DataHeader and the codes
+ * Sequence is incremented for every capture, sent or not
+ * Dropped is the number of captures not sent because the host was late since streaming started
+ */
+typedef struct 
+{
+    uint32_t    sequence;
+    uint32_t    dropped;
+}DSOUSB_StreamHeader;
+
+/**
+ * Screenshot : sent after the EVENT/SCREENSHOT word (value=height), followed by the RLE stream cut
+ * in blocks : 1 byte length (1..64) + data, a zero length block ends the stream
+ * RLE is the same as the bitmaps : RLE_MARKER value count, anything else is a literal
+ * Runs never span two lines
+ */
+#define DSOUSB_RLE_MARKER DSO_RLE_MARKER // see DSORleEncoder
+enum DSOUSB_PixelFormat
+{
+    PIXEL_RGB332=1  // RRRGGGBB
+};
+typedef struct 
+{
+    uint16_t    width;
+    uint16_t    height;
+    uint8_t     format;         // DSOUSB_PixelFormat
+    uint8_t     marker;         // DSOUSB_RLE_MARKER
+}DSOUSB_ScreenHeader;
+
 enum DSOUSB_VOLTAGE
 {
         GND=0,
@@ -33,8 +148,8 @@ enum DSOUSB_VOLTAGE
         mV200=6,
         mV500=7,
         V1=8,
-        V5=9,
- 
+        V2=9,
+        V5=10   // same order as DSO_VOLTAGE_RANGE
 };
 enum DSOUSB_TIMEBASE
 {
@@ -8,6 +8,7 @@
 #include "dso_menuEngine.h"
 #include "dso_global.h"
 #include "dso_calibrate.h"
+#include "dso_perf.h"
 extern testSignal *myTestSignal;
 
 extern void buttonTest(void);
@@ -32,6 +33,19 @@ void range1()
     myTestSignal->setAmplitude(true);
 }        
         
+void persistenceOff()
+{
+    DSODisplay::setPersistence(DSODisplay::PERSISTENCE_OFF);
+}
+void persistenceDecay()
+{
+    DSODisplay::setPersistence(DSODisplay::PERSISTENCE_DECAY);
+}
+void persistenceInfinite()
+{
+    DSODisplay::setPersistence(DSODisplay::PERSISTENCE_INFINITE);
+}
+
 #define FQ_MENU(x,y)     {MenuItem::MENU_CALL, x,(void *)fq##y},     
 const MenuItem  fqMenu[]=
 {
@@ -60,11 +74,21 @@ const MenuItem  signalMenu[]=
     {MenuItem::MENU_BACK, "Back",NULL},
     {MenuItem::MENU_END, NULL,NULL}
 };
+const MenuItem  persistenceMenu[]=
+{
+    {MenuItem::MENU_TITLE, "Persistence",NULL},
+    {MenuItem::MENU_CALL, "Off",(const void *)persistenceOff},
+    {MenuItem::MENU_CALL, "Decay",(const void *)persistenceDecay},
+    {MenuItem::MENU_CALL, "Infinite",(const void *)persistenceInfinite},
+    {MenuItem::MENU_BACK, "Back",NULL},
+    {MenuItem::MENU_END, NULL,NULL}
+};
 const MenuItem  calibrationMenu[]=
 {
     {MenuItem::MENU_TITLE, "Calibration",NULL},
     {MenuItem::MENU_CALL, "Basic Calibrate",(const void *)DSOCalibrate::zeroCalibrate},    
     {MenuItem::MENU_CALL, "Fine Calibrate",(const void *)DSOCalibrate::voltageCalibrate},
+    {MenuItem::MENU_CALL, "Linearity Calibrate",(const void *)DSOCalibrate::linearityCalibrate},
     {MenuItem::MENU_CALL, "Wipe Calibration",(const void *)DSOCalibrate::decalibrate},
     {MenuItem::MENU_BACK, "Back",NULL},
     {MenuItem::MENU_END, NULL,NULL}
@@ -73,6 +97,8 @@ const MenuItem  topMenu[]={
     {MenuItem::MENU_TITLE, "Main Menu",NULL},
     {MenuItem::MENU_SUBMENU, "Test signal",(const void *)&signalMenu},
     {MenuItem::MENU_CALL, "Button Test",(const void *)buttonTest},
+    {MenuItem::MENU_SUBMENU, "Persistence",(const void *)&persistenceMenu},
+    {MenuItem::MENU_CALL, "Perf overlay",(const void *)DSOPerf::toggleOverlay},
     {MenuItem::MENU_SUBMENU, "Calibration",(const void *)&calibrationMenu},
     {MenuItem::MENU_BACK, "Back",NULL},
     {MenuItem::MENU_END, NULL,NULL}
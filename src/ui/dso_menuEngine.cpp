@@ -7,6 +7,7 @@
 #include "dso_includes.h"
 #include "dso_menuEngine.h"
 #include "dso_global.h"
+extern void dsoUsb_processBusy();
 
 
 #define USE_MENU_BUTTON DSOControl::DSO_BUTTON_ROTARY
@@ -118,6 +119,7 @@ next:
         while(1)
         { 
                   xDelay(10); // dont busy loop
+                  dsoUsb_processBusy();
                   
                   int okEvent=controlButtons->getButtonEvents(DSOControl::DSO_BUTTON_OK);
                   if(okEvent&EVENT_SHORT_PRESS)
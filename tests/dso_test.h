@@ -0,0 +1,25 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+#pragma once
+/**
+ * Minimal host test helpers, a failed check is printed and the test exits with 1
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static int dsoTestFailures=0;
+
+#define CHECK(x) do{ if(!(x)) { printf("%s:%d: CHECK(%s) failed\n",__FILE__,__LINE__,#x); dsoTestFailures++; } }while(0)
+#define CHECK_EQ(a,b) do{ long long _a=(long long)(a),_b=(long long)(b); \
+        if(_a!=_b) { printf("%s:%d: %s=%lld, expected %lld\n",__FILE__,__LINE__,#a,_a,_b); dsoTestFailures++; } }while(0)
+#define CHECK_STR(a,b) do{ const char *_a=(a),*_b=(b); \
+        if(strcmp(_a,_b)) { printf("%s:%d: %s=\"%s\", expected \"%s\"\n",__FILE__,__LINE__,#a,_a,_b); dsoTestFailures++; } }while(0)
+#define CHECK_NEAR(a,b,tol) do{ double _a=(a),_b=(b); \
+        if(!(fabs(_a-_b)<=(tol))) { printf("%s:%d: %s=%g, expected %g +- %g\n",__FILE__,__LINE__,#a,_a,_b,(double)(tol)); dsoTestFailures++; } }while(0)
+
+#define TEST_RESULT() (dsoTestFailures ? (printf("%d check(s) failed\n",dsoTestFailures),1) : (printf("OK\n"),0))
+// EOF
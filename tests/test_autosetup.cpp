@@ -0,0 +1,106 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// Auto setup estimator over a corpus of synthetic signals
+#include <stdint.h>
+#include "dso_test.h"
+#include "dso_autoSetup.h"
+
+#define N        240
+#define DT       (1./24000.)   // 1 ms/div, 10 ms window
+#define FULL     2.f           // range full scale, V
+
+enum Shape {SINE,SQUARE,TRIANGLE,SAW,NB_SHAPES};
+static uint32_t seed=1;
+/**
+ * Uniform noise in [-1,1], deterministic
+ */
+static float noise()
+{
+    seed=seed*1664525+1013904223;
+    return (float)(seed>>8)/(float)(1<<23)-1.f;
+}
+static float wave(Shape s, float phase) // phase in periods
+{
+    float x=phase-floorf(phase);
+    switch(s)
+    {
+        case SINE:     return sinf(2.f*(float)M_PI*x);
+        case SQUARE:   return x<0.5f ? 1.f : -1.f;
+        case TRIANGLE: return x<0.5f ? 4.f*x-1.f : 3.f-4.f*x;
+        case SAW:      return 2.f*x-1.f;
+        default:       return 0;
+    }
+}
+static void make(float *out, Shape s, float period, float amplitude, float offset, float noiseLevel, float phase0)
+{
+    for(int i=0;i<N;i++)
+        out[i]=offset+amplitude*wave(s,phase0+(float)(i*DT)/period)+noiseLevel*amplitude*noise();
+}
+
+int main(int argc, char **argv)
+{
+    float samples[N];
+    AutoSetupProbe p;
+
+    // DC, and a swing below 5% of the full scale, are flat
+    make(samples,SINE,1e-3f,0.f,0.7f,0.f,0.f);
+    DSOAutoSetup::estimate(samples,N,DT,FULL,p);
+    CHECK(p.flat);
+    CHECK_NEAR(p.xmin,0.7,1e-6);
+    make(samples,SINE,1e-3f,0.04f,0.f,0.f,0.f);
+    DSOAutoSetup::estimate(samples,N,DT,FULL,p);
+    CHECK(p.flat);
+    CHECK_EQ(p.period,0);
+
+    // less than 2 rising crossings : no period
+    make(samples,SINE,20e-3f,1.f,0.f,0.f,0.f);
+    DSOAutoSetup::estimate(samples,N,DT,FULL,p);
+    CHECK(!p.flat);
+    CHECK(p.crossings<2);
+    CHECK_EQ(p.period,0);
+
+    // corpus : shapes x periods x amplitudes x offsets x noise x phases
+    // from 2.5 periods to 4 samples per period in the window, below that auto setup
+    // switches to a faster time base (an aliased signal is not detectable from the samples)
+    const float periods[]={4e-3f,2.5e-3f,1e-3f,0.5e-3f,0.3e-3f,0.2e-3f,0.17e-3f};
+    const float amplitudes[]={0.1f,0.5f,1.f};
+    const float offsets[]={0.f,-0.3f,0.5f};
+    const float noises[]={0.f,0.02f,0.05f};
+    int total=0,converged=0;
+    for(int s=0;s<NB_SHAPES;s++)
+    for(size_t t=0;t<sizeof(periods)/sizeof(float);t++)
+    for(size_t a=0;a<sizeof(amplitudes)/sizeof(float);a++)
+    for(size_t o=0;o<sizeof(offsets)/sizeof(float);o++)
+    for(size_t z=0;z<sizeof(noises)/sizeof(float);z++)
+    for(int ph=0;ph<4;ph++)
+    {
+        float period=periods[t];
+        make(samples,(Shape)s,period,amplitudes[a],offsets[o],noises[z],0.25f*(float)ph+0.1f);
+        DSOAutoSetup::estimate(samples,N,DT,FULL,p);
+        total++;
+        // amplitude : the peaks can fall between two samples (1/8 period at worst), plus the noise
+        float pp=p.xmax-p.xmin;
+        float truePP=2.f*amplitudes[a];
+        bool ok=!p.flat && pp>=truePP*(0.75f-noises[z]) && pp<=truePP*(1.f+noises[z])+1e-4f;
+        // period : clean, the crossings are on sample boundaries, i.e. 2.5 samples over the span
+        // noisy, the noise moves the crossings on slow edges, within 10% is still the right
+        // time base as they are 2 to 2.5x apart
+        if(ok && p.crossings>=2)
+        {
+            float span=p.period*(float)(p.crossings-1);
+            float tol=noises[z] ? 0.1f*period : period*(2.5f*(float)DT/span);
+            ok=fabsf(p.period-period)<=tol;
+        }else
+            ok=false;
+        if(ok) converged++;
+        else printf("miss : shape %d period %g amp %g offset %g noise %g phase %d -> period %g crossings %d\n",
+                        s,period,amplitudes[a],offsets[o],noises[z],ph,p.period,p.crossings);
+    }
+    printf("converged %d/%d\n",converged,total);
+    CHECK_EQ(converged,total);
+    return TEST_RESULT();
+}
+// EOF
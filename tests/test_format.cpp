@@ -0,0 +1,89 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// DSOFormat : integer readouts, rounding and range boundaries
+#include <limits.h>
+#include "dso_test.h"
+#include "dso_format.h"
+
+static const char *fq(int f)
+{
+    static char out[DSO_FORMAT_BUFFER_SIZE];
+    return DSOFormat::frequency(f,out);
+}
+static const char *volt(float v)
+{
+    static char out[DSO_FORMAT_BUFFER_SIZE];
+    return DSOFormat::voltage(v,out);
+}
+static const char *sci(float v)
+{
+    static char out[DSO_FORMAT_BUFFER_SIZE];
+    return DSOFormat::scientific(v,out);
+}
+static const char *integer(int v, int digits)
+{
+    static char out[DSO_FORMAT_BUFFER_SIZE];
+    DSOFormat::printInt(out,v,digits);
+    return out;
+}
+
+int main(int argc, char **argv)
+{
+    CHECK_STR(integer(0,1),"0");
+    CHECK_STR(integer(42,1),"42");
+    CHECK_STR(integer(7,3),"007");
+    CHECK_STR(integer(-7,3),"-007");
+    CHECK_STR(integer(1234,2),"1234");
+    CHECK_STR(integer(INT_MIN,1),"-2147483648");
+
+    // below 1 kHz : plain integer, then one decimal with k / M
+    CHECK_STR(fq(0),"0");
+    CHECK_STR(fq(50),"50");
+    CHECK_STR(fq(999),"999");
+    CHECK_STR(fq(1000),"1.0k");
+    CHECK_STR(fq(1249),"1.2k");
+    CHECK_STR(fq(1250),"1.3k");
+    CHECK_STR(fq(999949),"999.9k");
+    CHECK_STR(fq(999950),"1.0M");  // rounds up to the next unit
+    CHECK_STR(fq(1000000),"1.0M");
+    CHECK_STR(fq(2500000),"2.5M");
+    CHECK_STR(fq(12345678),"12.3M");
+
+    // u below 1 mV, m below 0.8 V, then volts with 2 decimals
+    CHECK_STR(volt(0),"000u");
+    CHECK_STR(volt(0.0000004f),"000u");
+    CHECK_STR(volt(0.0000006f),"001u");
+    CHECK_STR(volt(0.000999f),"999u");
+    CHECK_STR(volt(-0.000005f),"-05u");
+    CHECK_STR(volt(0.0009996f),"001m");
+    CHECK_STR(volt(0.0123f),"012m");
+    CHECK_STR(volt(-0.0123f),"-12m");
+    CHECK_STR(volt(-0.123f),"-123m");
+    CHECK_STR(volt(0.0125f),"013m");   // nearest, not truncated
+    CHECK_STR(volt(0.7999f),"800m");
+    CHECK_STR(volt(0.8f),"0.80");
+    CHECK_STR(volt(1.234f),"1.23");
+    CHECK_STR(volt(1.236f),"1.24");
+    CHECK_STR(volt(-2.5f),"-2.50");
+    CHECK_STR(volt(12.5f),"12.50");
+
+    // SCPI NR3, 5 significant digits
+    CHECK_STR(sci(0),"0.0000E+00");
+    CHECK_STR(sci(5e-6f),"5.0000E-06");
+    CHECK_STR(sci(0.001f),"1.0000E-03");
+    CHECK_STR(sci(1.f),"1.0000E+00");
+    CHECK_STR(sci(2.5f),"2.5000E+00");
+    CHECK_STR(sci(-1.2345f),"-1.2345E+00");
+    CHECK_STR(sci(123456.f),"1.2346E+05");
+    CHECK_STR(sci(9.99996f),"1.0000E+01");
+    CHECK_STR(sci(-0.5f),"-5.0000E-01");
+    CHECK_STR(sci(1e-20f),"1.0000E-20");
+    CHECK_STR(sci(NAN),"9.91E+37");
+    CHECK_STR(sci(INFINITY),"9.91E+37");
+    CHECK_STR(sci(-INFINITY),"9.91E+37");
+    return TEST_RESULT();
+}
+// EOF
@@ -0,0 +1,95 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// Linearity correction : knots from measured points, integer interpolation
+#include "dso_test.h"
+#include "dso_adc_gain.h"
+
+/**
+ * Synthetic ADC with a bow : reads low in the middle of the range, by up to 3 LSB
+ */
+static float adcError(float code)
+{
+    float x=code/4095.f;
+    return -12.f*x*(1.f-x);
+}
+
+int main(int argc, char **argv)
+{
+    int16_t table[LINEARITY_KNOTS];
+
+    // no correction
+    for(int k=0;k<LINEARITY_KNOTS;k++) table[k]=0;
+    for(int code=0;code<4096;code+=37)
+        CHECK_EQ(DSOInputGain::linearize16(table,code),code<<4);
+    CHECK_EQ(DSOInputGain::linearize16(table,4095),4095<<4);
+
+    // constant offset
+    for(int k=0;k<LINEARITY_KNOTS;k++) table[k]=-24;
+    CHECK_EQ(DSOInputGain::linearize16(table,100),(100<<4)-24);
+    CHECK_EQ(DSOInputGain::linearize16(table,4095),(4095<<4)-24);
+
+    // interpolation between knots, exact on the knots, rounded toward -inf in between
+    for(int k=0;k<LINEARITY_KNOTS;k++) table[k]=(k&1) ? 32 : 0;
+    CHECK_EQ(DSOInputGain::linearize16(table,512),(512<<4)+32);
+    CHECK_EQ(DSOInputGain::linearize16(table,256),(256<<4)+16);
+    CHECK_EQ(DSOInputGain::linearize16(table,512+256),((512+256)<<4)+16);
+    CHECK_EQ(DSOInputGain::linearize16(table,512+1),((512+1)<<4)+31); // 32-1/16 floors to 31
+    CHECK_EQ(DSOInputGain::linearize16(table,1),(1<<4)+0);
+
+    // one point : flat table
+    {
+        int codes[]={2000},deltas[]={40};
+        DSOInputGain::computeKnots(1,codes,deltas,table);
+        for(int k=0;k<LINEARITY_KNOTS;k++)
+            CHECK_EQ(table[k],40);
+    }
+    // two points : flat outside, linear inside
+    {
+        int codes[]={1024,3072},deltas[]={-16,16};
+        DSOInputGain::computeKnots(2,codes,deltas,table);
+        CHECK_EQ(table[0],-16);
+        CHECK_EQ(table[1],-16);
+        CHECK_EQ(table[2],-16);  // 1024
+        CHECK_EQ(table[3],-8);
+        CHECK_EQ(table[4],0);    // 2048
+        CHECK_EQ(table[5],8);
+        CHECK_EQ(table[6],16);   // 3072
+        CHECK_EQ(table[8],16);
+    }
+    // clamped to int16
+    {
+        int codes[]={0,4096},deltas[]={-100000,100000};
+        DSOInputGain::computeKnots(2,codes,deltas,table);
+        CHECK_EQ(table[0],-32768);
+        CHECK_EQ(table[8],32767);
+    }
+    // end to end : measure the bow at a few codes, the corrected codes are within
+    // a fraction of a LSB everywhere, vs 3 LSB uncorrected
+    {
+        int codes[7],deltas[7];
+        for(int i=0;i<7;i++)
+        {
+            codes[i]=i*4095/6;
+            deltas[i]=(int)(-16.f*adcError((float)codes[i])+0.5f);
+        }
+        DSOInputGain::computeKnots(7,codes,deltas,table);
+        float worst=0,worstRaw=0;
+        for(int truth=0;truth<4096;truth++)
+        {
+            int raw=(int)((float)truth+adcError((float)truth)+0.5f);
+            if(raw<0) raw=0;
+            float corrected=(float)DSOInputGain::linearize16(table,raw)/16.f;
+            float e=fabsf(corrected-(float)truth);
+            if(e>worst) worst=e;
+            float r=fabsf((float)raw-(float)truth);
+            if(r>worstRaw) worstRaw=r;
+        }
+        CHECK(worstRaw>2.5f);
+        CHECK(worst<0.75f);
+    }
+    return TEST_RESULT();
+}
+// EOF
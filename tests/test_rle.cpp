@@ -0,0 +1,131 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// DSORleEncoder : block framing and round trip through a reference decoder
+#include <stdlib.h>
+#include <vector>
+#include "dso_test.h"
+#include "dso_rle.h"
+
+static std::vector<uint8_t> stream;
+static int maxBlock;
+
+static void collect(const uint8_t *data, int len)
+{
+    stream.insert(stream.end(),data,data+len);
+}
+/**
+ * Encode a width x height image, line by line as the firmware does
+ */
+static void encode(const std::vector<uint8_t> &img, int width, int height)
+{
+    stream.clear();
+    DSORleEncoder rle(collect);
+    for(int y=0;y<height;y++)
+    {
+        for(int x=0;x<width;x++)
+            rle.add(img[y*width+x]);
+        rle.endLine();
+        if(y&1) rle.flushBlock(); // the screenshot flushes after each row
+    }
+    rle.end();
+}
+/**
+ * Reference decoder, same as pyDSO150 rle_decode after removing the block lengths
+ * A run must not cross a line nor a block
+ * @return false if the stream is malformed
+ */
+static bool decode(std::vector<uint8_t> &img, int width, int height)
+{
+    img.assign(width*height,0);
+    size_t i=0;
+    int o=0;
+    maxBlock=0;
+    while(1)
+    {
+        if(i>=stream.size()) return false;
+        int len=stream[i++];
+        if(!len) break;
+        if(len>maxBlock) maxBlock=len;
+        size_t end=i+len;
+        if(end>stream.size()) return false;
+        while(i<end)
+        {
+            int value=stream[i++];
+            int count=1;
+            if(value==DSO_RLE_MARKER)
+            {
+                if(i+2>end) return false;
+                value=stream[i];
+                count=stream[i+1];
+                i+=2;
+                if(!count) return false;
+            }
+            if(o+count>width*height) return false;
+            if((o%width)+count>width) return false; // spans two lines
+            for(int k=0;k<count;k++)
+                img[o++]=value;
+        }
+    }
+    return i==stream.size() && o==width*height;
+}
+static void roundTrip(const std::vector<uint8_t> &img, int width, int height)
+{
+    std::vector<uint8_t> out;
+    encode(img,width,height);
+    CHECK(decode(out,width,height));
+    CHECK(out==img);
+    CHECK(maxBlock<=DSO_RLE_BLOCK);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<uint8_t> img;
+
+    // short runs are literals, long ones and the marker are escaped
+    img={1,2,2,3,3,3,4,4,4,4,DSO_RLE_MARKER};
+    encode(img,11,1);
+    const uint8_t expected[]={12, 1,2,2,3,3,3, DSO_RLE_MARKER,4,4, DSO_RLE_MARKER,DSO_RLE_MARKER,1, 0};
+    CHECK_EQ(stream.size(),sizeof(expected));
+    CHECK(!memcmp(stream.data(),expected,sizeof(expected)));
+    roundTrip(img,11,1);
+
+    // runs are capped at 255 and end with the line
+    img.assign(2*320,0);
+    encode(img,320,2);
+    const uint8_t black[]={12, DSO_RLE_MARKER,0,255, DSO_RLE_MARKER,0,65, DSO_RLE_MARKER,0,255, DSO_RLE_MARKER,0,65, 0};
+    CHECK_EQ(stream.size(),sizeof(black));
+    CHECK(!memcmp(stream.data(),black,sizeof(black)));
+    roundTrip(img,320,2);
+
+    // worst case : marker every other pixel, 2 bytes per pixel, runs never split between blocks
+    img.resize(320*3);
+    for(size_t i=0;i<img.size();i++)
+        img[i]=(i&1) ? DSO_RLE_MARKER : 0x11;
+    roundTrip(img,320,3);
+    CHECK(stream.size()<=2*img.size()+2*img.size()/(DSO_RLE_BLOCK-2)+2);
+
+    // random screens with a few colours, like the grid & traces
+    srand(1);
+    for(int t=0;t<50;t++)
+    {
+        int width=1+rand()%320,height=1+rand()%8;
+        img.resize(width*height);
+        for(size_t i=0;i<img.size();i++)
+        {
+            if(i && rand()%4) img[i]=img[i-1];
+            else img[i]=(rand()%3==0) ? DSO_RLE_MARKER : rand()%256;
+        }
+        roundTrip(img,width,height);
+    }
+
+    // empty image : only the end block
+    img.clear();
+    encode(img,0,0);
+    CHECK_EQ(stream.size(),1);
+    CHECK_EQ(stream[0],0);
+    return TEST_RESULT();
+}
+// EOF
@@ -0,0 +1,163 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// Rotary encoder : timing sequences replayed through the acceleration & burst logic
+#include "dso_test.h"
+#include "dso_rotary.h"
+
+#define MAIN_LOOP_MS 30 // main loop period between two readRotary
+
+/**
+ * Simulated encoder, detents are delivered as the simulated clock passes them
+ * exactly like the interrupt does on the target
+ */
+static const int *detentTimes;
+static const int *detentDirs;
+static int       nbDetents;
+static int       nextDetent;
+static uint32_t  simNow;
+static uint32_t  lastDetent;
+static int       counter,accelCounter;
+static bool      accelerated;
+static int       polls;
+
+static void deliver()
+{
+    while(nextDetent<nbDetents && (uint32_t)detentTimes[nextDetent]<=simNow)
+    {
+        uint32_t t=detentTimes[nextDetent];
+        int dir=detentDirs ? detentDirs[nextDetent] : 1;
+        counter+=dir;
+        accelCounter+=dir*DSORotary::accelStep(t-lastDetent);
+        lastDetent=t;
+        nextDetent++;
+    }
+}
+static int take()
+{
+    deliver();
+    int r=accelerated ? accelCounter : counter;
+    counter=accelCounter=0;
+    return r;
+}
+static int poll(int waitMs)
+{
+    polls++;
+    simNow+=waitMs;
+    return take();
+}
+static uint32_t simClock()
+{
+    return simNow;
+}
+
+/**
+ * Run the main loop over the whole sequence
+ * @return number of settings changes, their sum in total
+ */
+static int replay(const int *times, const int *dirs, int n, bool accel, int &total, int *maxPolls=NULL)
+{
+    detentTimes=times;detentDirs=dirs;nbDetents=n;nextDetent=0;
+    simNow=0;lastDetent=(uint32_t)-1000;counter=accelCounter=0;accelerated=accel;
+    int changes=0;
+    total=0;
+    if(maxPolls) *maxPolls=0;
+    int end=times[n-1]+10*ROTARY_BURST_MAX;
+    while((int)simNow<end)
+    {
+        polls=0;
+        int inc=DSORotary::burst(take(),poll,simClock);
+        if(maxPolls && polls>*maxPolls) *maxPolls=polls;
+        if(inc)
+        {
+            changes++;
+            total+=inc;
+        }
+        simNow+=MAIN_LOOP_MS;
+    }
+    return changes;
+}
+
+static int times[200];
+
+static void regular(int n, int spacing, int start=0)
+{
+    for(int i=0;i<n;i++)
+        times[i]=start+i*spacing;
+}
+
+int main(int argc, char **argv)
+{
+    int total;
+    // thresholds
+    CHECK_EQ(DSORotary::accelStep(0),4);
+    CHECK_EQ(DSORotary::accelStep(24),4);
+    CHECK_EQ(DSORotary::accelStep(25),2);
+    CHECK_EQ(DSORotary::accelStep(59),2);
+    CHECK_EQ(DSORotary::accelStep(60),1);
+    CHECK_EQ(DSORotary::accelStep(5000),1);
+    CHECK_EQ(DSORotary::accelStep((uint32_t)-5),1); // millis() went backward / first detent
+
+    // nothing to collect, nothing waited
+    polls=0;
+    CHECK_EQ(DSORotary::burst(0,poll,simClock),0);
+    CHECK_EQ(polls,0);
+
+    // slow turn : one change per detent, no acceleration
+    regular(5,200);
+    CHECK_EQ(replay(times,NULL,5,false,total),5);
+    CHECK_EQ(total,5);
+    CHECK_EQ(replay(times,NULL,5,true,total),5);
+    CHECK_EQ(total,5);
+
+    // fast spin, 10 ms per detent : coalesced, accelerated x4 after the first one
+    regular(20,10);
+    int changes=replay(times,NULL,20,false,total);
+    CHECK_EQ(total,20);
+    CHECK(changes>=1 && changes<=2);
+    changes=replay(times,NULL,20,true,total);
+    CHECK_EQ(total,1+19*4);
+    CHECK(changes>=1 && changes<=2);
+
+    // medium spin, 40 ms per detent : x2
+    regular(10,40);
+    replay(times,NULL,10,false,total);
+    CHECK_EQ(total,10);
+    replay(times,NULL,10,true,total);
+    CHECK_EQ(total,1+9*2);
+
+    // spin slowing down : 10 ms, then 40 ms, then 100 ms
+    {
+        int t=0,n=0;
+        for(int i=0;i<5;i++) {times[n++]=t;t+=10;}
+        for(int i=0;i<5;i++) {times[n++]=t;t+=40;}
+        for(int i=0;i<5;i++) {times[n++]=t;t+=100;}
+        replay(times,NULL,n,true,total);
+        CHECK_EQ(total,1+4*4+1*4+4*2+1*2+4*1);
+    }
+
+    // back and forth, fast : cancels out
+    {
+        int dirs[20];
+        regular(20,10);
+        for(int i=0;i<20;i++) dirs[i]= i<10 ? 1 : -1;
+        replay(times,dirs,20,false,total);
+        CHECK_EQ(total,0);
+        replay(times,dirs,20,true,total);
+        CHECK_EQ(total,(1+9*4)-10*4);
+    }
+
+    // endless spin : a burst never holds the UI more than ROTARY_BURST_MAX
+    {
+        int maxPolls;
+        regular(200,5);
+        changes=replay(times,NULL,200,false,total,&maxPolls);
+        CHECK_EQ(total,200);
+        CHECK(maxPolls<=ROTARY_BURST_MAX/ROTARY_BURST_GAP);
+        CHECK(changes>=1000/(ROTARY_BURST_MAX+MAIN_LOOP_MS));
+    }
+    return TEST_RESULT();
+}
+// EOF
@@ -0,0 +1,129 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// DSOScpi : header matching, numbers, compound lines and errors
+#include "dso_test.h"
+#include "dso_scpi.h"
+
+static int  calls;
+static bool lastQuery;
+static char lastArg[32];
+static int  lastCommand;
+
+static int record(int command, bool query, const DSOScpi::Token &arg)
+{
+    calls++;
+    lastCommand=command;
+    lastQuery=query;
+    memcpy(lastArg,arg.text,arg.len);
+    lastArg[arg.len]=0;
+    return DSOScpi::ERR_NONE;
+}
+static int idn(bool query, const DSOScpi::Token &arg)   {return record(0,query,arg);}
+static int scale(bool query, const DSOScpi::Token &arg) {return record(1,query,arg);}
+static int chan(bool query, const DSOScpi::Token &arg)  {return record(2,query,arg);}
+static int fail(bool query, const DSOScpi::Token &arg)
+{
+    record(3,query,arg);
+    return DSOScpi::ERR_DATA_OUT_OF_RANGE;
+}
+static const DSOScpi::Command table[]=
+{
+    {"*IDN",                idn},
+    {":TIMebase:SCALe",     scale},
+    {":CHANnel:SCALe",      chan},
+    {":TRIGger:LEVel",      fail},
+};
+#define NB (int)(sizeof(table)/sizeof(table[0]))
+
+static int run(const char *line)
+{
+    calls=0;
+    lastArg[0]=0;
+    lastCommand=-1;
+    return DSOScpi::execute(line,strlen(line),table,NB);
+}
+static bool match(const char *pattern, const char *header)
+{
+    DSOScpi::Token t={header,(int)strlen(header)};
+    return DSOScpi::matchHeader(pattern,t);
+}
+static bool number(const char *text, float &f)
+{
+    DSOScpi::Token t={text,(int)strlen(text)};
+    return DSOScpi::toFloat(t,f);
+}
+
+int main(int argc, char **argv)
+{
+    // short / long form, case, optional leading ':', suffix 1 only
+    CHECK(match(":TIMebase:SCALe",":TIM:SCAL"));
+    CHECK(match(":TIMebase:SCALe","timebase:scale"));
+    CHECK(match(":TIMebase:SCALe",":TimeBase:Scal"));
+    CHECK(!match(":TIMebase:SCALe",":TIME:SCAL"));     // neither short nor long
+    CHECK(!match(":TIMebase:SCALe",":TIM"));
+    CHECK(!match(":TIMebase:SCALe",":TIM:SCAL:X"));
+    CHECK(match(":CHANnel:SCALe",":CHAN1:SCAL"));
+    CHECK(!match(":CHANnel:SCALe",":CHAN2:SCAL"));
+    CHECK(!match(":CHANnel:SCALe",":CHAN11:SCAL"));
+    CHECK(match("*IDN","*idn"));
+
+    float f;
+    CHECK(number("1",f));       CHECK_NEAR(f,1.,1e-6);
+    CHECK(number("-2.5",f));    CHECK_NEAR(f,-2.5,1e-6);
+    CHECK(number("+.5",f));     CHECK_NEAR(f,0.5,1e-6);
+    CHECK(number("5E-6",f));    CHECK_NEAR(f,5e-6,1e-11);
+    CHECK(number("1.5e+3",f));  CHECK_NEAR(f,1500.,1e-3);
+    CHECK(number("2.",f));      CHECK_NEAR(f,2.,1e-6);
+    CHECK(!number("",f));
+    CHECK(!number("-",f));
+    CHECK(!number(".",f));
+    CHECK(!number("1E",f));
+    CHECK(!number("1E+",f));
+    CHECK(!number("1.2.3",f));
+    CHECK(!number("12V",f));
+    CHECK(!number("1E39",f));
+
+    // query, argument trimmed
+    CHECK_EQ(run("*IDN?"),DSOScpi::ERR_NONE);
+    CHECK_EQ(calls,1);
+    CHECK_EQ(lastCommand,0);
+    CHECK(lastQuery);
+    CHECK_STR(lastArg,"");
+    CHECK_EQ(run("  :tim:scal   1E-3  "),DSOScpi::ERR_NONE);
+    CHECK_EQ(lastCommand,1);
+    CHECK(!lastQuery);
+    CHECK_STR(lastArg,"1E-3");
+    CHECK_EQ(run(":TIM:SCAL?"),DSOScpi::ERR_NONE);
+    CHECK(lastQuery);
+
+    // compound line, each command starts at the root, empty commands are skipped
+    CHECK_EQ(run(":TIM:SCAL 1;:CHAN1:SCAL 0.5;;"),DSOScpi::ERR_NONE);
+    CHECK_EQ(calls,2);
+    CHECK_EQ(lastCommand,2);
+    CHECK_STR(lastArg,"0.5");
+
+    // errors stop the line
+    CHECK_EQ(run(":FOO:BAR 1;*IDN?"),DSOScpi::ERR_UNDEFINED_HEADER);
+    CHECK_EQ(calls,0);
+    CHECK_EQ(run(":TRIG:LEV 1;*IDN?"),DSOScpi::ERR_DATA_OUT_OF_RANGE);
+    CHECK_EQ(calls,1);
+    CHECK_EQ(run(""),DSOScpi::ERR_NONE);
+    CHECK_EQ(calls,0);
+
+    // queries only (the UI is busy) : queries run, commands are refused
+    calls=0;
+    CHECK_EQ(DSOScpi::execute("*IDN?;:TIM:SCAL?",16,table,NB,true),DSOScpi::ERR_NONE);
+    CHECK_EQ(calls,2);
+    calls=0;
+    CHECK_EQ(DSOScpi::execute("*IDN?;:TIM:SCAL 1",17,table,NB,true),DSOScpi::ERR_SETTINGS_CONFLICT);
+    CHECK_EQ(calls,1);
+    CHECK_EQ(DSOScpi::execute(":FOO?",5,table,NB,true),DSOScpi::ERR_UNDEFINED_HEADER);
+
+    CHECK_STR(DSOScpi::errorText(DSOScpi::ERR_UNDEFINED_HEADER),"Undefined header");
+    CHECK_STR(DSOScpi::errorText(12345),"Unknown error");
+    return TEST_RESULT();
+}
+// EOF
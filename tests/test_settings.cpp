@@ -0,0 +1,134 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// DSOSettingsRecord against a RAM model of the emulated eeprom, including power loss
+#include <map>
+#include "dso_test.h"
+#include "dso_settingsRecord.h"
+
+#define OFFSET 256
+/**
+ * Words never written read as missing, like the emulated eeprom
+ * After budget writes the power is "lost" : the next writes do not happen
+ */
+class RamWords : public DSOWordStorage
+{
+public:
+    RamWords() {budget=-1;writes=0;}
+    virtual bool read(int address, uint16_t &value)
+    {
+        std::map<int,uint16_t>::iterator it=words.find(address);
+        if(it==words.end()) return false;
+        value=it->second;
+        return true;
+    }
+    virtual void write(int address, uint16_t value)
+    {
+        if(budget==0) return;
+        if(budget>0) budget--;
+        writes++;
+        words[address]=value;
+    }
+    std::map<int,uint16_t> words;
+    int budget;
+    int writes;
+};
+static DSOSettings make(int n)
+{
+    DSOSettings s;
+    memset(&s,0,sizeof(s));
+    s.timeBase=n%17;
+    s.voltageRange=(n*3)%11;
+    s.triggerMode=n%4;
+    s.armingMode=n%3;
+    s.triggerValue=0.1f*(float)n;
+    s.voltageOffset=-0.05f*(float)n;
+    return s;
+}
+static bool same(const DSOSettings &a, const DSOSettings &b)
+{
+    return !memcmp(&a,&b,sizeof(a));
+}
+
+int main(int argc, char **argv)
+{
+    DSOSettings s;
+    {
+        RamWords ram;
+        CHECK(!DSOSettingsRecord::read(ram,OFFSET,s));
+
+        // round trip, then alternate slots
+        CHECK_EQ(DSOSettingsRecord::write(ram,OFFSET,make(1)),DSO_SETTINGS_SLOT_WORDS);
+        CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+        CHECK(same(s,make(1)));
+        CHECK(ram.words.count(OFFSET) && !ram.words.count(OFFSET+DSO_SETTINGS_SLOT_SPAN));
+        DSOSettingsRecord::write(ram,OFFSET,make(2));
+        CHECK(ram.words.count(OFFSET+DSO_SETTINGS_SLOT_SPAN));
+        CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+        CHECK(same(s,make(2)));
+
+        // unchanged : nothing written
+        int before=ram.writes;
+        CHECK_EQ(DSOSettingsRecord::write(ram,OFFSET,make(2)),0);
+        CHECK_EQ(ram.writes,before);
+
+        // back to settings the older slot holds : only sequence & crc change
+        CHECK_EQ(DSOSettingsRecord::write(ram,OFFSET,make(1)),2);
+        CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+        CHECK(same(s,make(1)));
+    }
+    // power loss after each possible number of words : old or new, never anything else
+    for(int cut=0;cut<=DSO_SETTINGS_SLOT_WORDS;cut++)
+    {
+        RamWords ram;
+        for(int i=1;i<=5;i++)
+            DSOSettingsRecord::write(ram,OFFSET,make(i));
+        RamWords full=ram;
+        int needed=DSOSettingsRecord::write(full,OFFSET,make(42)); // unchanged words are skipped
+        ram.budget=cut;
+        DSOSettingsRecord::write(ram,OFFSET,make(42));
+        ram.budget=-1;
+        CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+        if(cut>=needed)
+            CHECK(same(s,make(42)));
+        else
+            CHECK(same(s,make(5)));
+        // and the next write goes through
+        DSOSettingsRecord::write(ram,OFFSET,make(43));
+        CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+        CHECK(same(s,make(43)));
+    }
+    // sequence wrap around
+    {
+        RamWords ram;
+        for(int i=0;i<70000;i++)
+        {
+            DSOSettingsRecord::write(ram,OFFSET,make(i));
+            if(i>65530 && i<65540)
+            {
+                CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+                CHECK(same(s,make(i)));
+            }
+        }
+        CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+        CHECK(same(s,make(69999)));
+    }
+    // corrupted newest slot or other version : fall back / reject
+    {
+        RamWords ram;
+        DSOSettingsRecord::write(ram,OFFSET,make(1));
+        DSOSettingsRecord::write(ram,OFFSET,make(2));
+        ram.words[OFFSET+DSO_SETTINGS_SLOT_SPAN+3]^=0x100;
+        CHECK(DSOSettingsRecord::read(ram,OFFSET,s));
+        CHECK(same(s,make(1)));
+        ram.words[OFFSET]=DSO_SETTINGS_VERSION+1;
+        CHECK(!DSOSettingsRecord::read(ram,OFFSET,s));
+    }
+    uint16_t check[]={0x3132,0x3334};
+    CHECK_EQ(DSOSettingsRecord::crc(check,0),0xffff);
+    CHECK(DSOSettingsRecord::crc(check,2)!=DSOSettingsRecord::crc(check,1));
+    return TEST_RESULT();
+}
+// EOF
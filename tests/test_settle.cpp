@@ -0,0 +1,96 @@
+/***************************************************
+ STM32 duino based firmware for DSO SHELL/150
+ *  * GPL v2
+ * (c) mean 2019 fixounet@free.fr
+ ****************************************************/
+// Calibration : when is the front end settled after a gain change
+#include <stdlib.h>
+#include "dso_test.h"
+#include "dso_calibrate_settle.h"
+
+/**
+ * Synthetic front end : exponential settling from start to target (LSB)
+ * tau in blocks, plus some noise on each block average
+ */
+static int settle(float start, float target, float tau, float noise16, int &value)
+{
+    DSOSettle s;
+    int block=0;
+    while(1)
+    {
+        float v=target+(start-target)*expf(-(float)block/tau);
+        float n=noise16*(2.f*(float)rand()/(float)RAND_MAX-1.f);
+        block++;
+        if(s.add((int)lrintf(v*16.f+n)))
+            break;
+        if(block>100) break;
+    }
+    value=s.value();
+    CHECK_EQ(s.blocks(),block);
+    return block;
+}
+
+int main(int argc, char **argv)
+{
+    int value;
+    srand(1);
+
+    // already settled : the minimum window
+    CHECK_EQ(settle(2048,2048,1,0,value),CALIBRATION_WINDOW);
+    CHECK_EQ(value,2048);
+
+    // rounding of the average, 1/16 LSB in
+    {
+        DSOSettle s;
+        for(int i=0;i<CALIBRATION_WINDOW;i++) s.add(100*16+8);
+        CHECK_EQ(s.value(),101);
+        DSOSettle t;
+        for(int i=0;i<CALIBRATION_WINDOW;i++) t.add(100*16+7);
+        CHECK_EQ(t.value(),100);
+    }
+
+    // small noise, well within the tolerance
+    CHECK_EQ(settle(2048,2048,1,3,value),CALIBRATION_WINDOW);
+    CHECK_EQ(value,2048);
+
+    // typical gain change : a few blocks, and the result within 1 LSB of the final level
+    for(float tau=0.5f;tau<=2.f;tau+=0.5f)
+        for(float start=1800;start<=2300;start+=100)
+        {
+            int blocks=settle(start,2048,tau,2,value);
+            CHECK(blocks<CALIBRATION_MAX_BLOCKS);
+            CHECK(abs(value-2048)<=1);
+        }
+
+    // the further away the start, the longer it takes
+    int near=settle(2040,2048,1.5,0,value);
+    int far =settle(1500,2048,1.5,0,value);
+    CHECK(far>near);
+
+    // never settles (e.g. unplugged probe picking up noise) : give up
+    {
+        DSOSettle s;
+        int blocks=0;
+        bool done=false;
+        while(!done && blocks<100)
+        {
+            done=s.add(blocks&1 ? 2000*16 : 2002*16);
+            blocks++;
+        }
+        CHECK(done);
+        CHECK_EQ(blocks,CALIBRATION_MAX_BLOCKS);
+        CHECK_EQ(s.value(),2001);
+    }
+
+    // just at the tolerance edge
+    {
+        DSOSettle s;
+        s.add(0);s.add(0);
+        CHECK(s.add(CALIBRATION_TOLERANCE));
+        DSOSettle t;
+        t.add(0);t.add(0);
+        CHECK(!t.add(CALIBRATION_TOLERANCE+1));
+    }
+    return TEST_RESULT();
+}
+// EOF
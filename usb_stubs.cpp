@@ -65,7 +65,15 @@ void dsoUsb_processNextCommand()
 {
     return ;
 }
-extern void dsoUsb_sendData(int count,float *data, CaptureStats &stats)
+void dsoUsb_processBusy()
 {
-    
+    return ;
+}
+extern bool dsoUsb_sendData(int count,float *data, CaptureStats &stats)
+{
+    return true;
+}
+extern bool dsoUsb_streamData(int count,float *data, CaptureStats &stats)
+{
+    return false;
 }